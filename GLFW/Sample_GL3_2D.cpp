@@ -3,6 +3,7 @@
 #include <ctime>
 #include <fstream>
 #include <vector>
+#include <string.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -12,6 +13,16 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "rules.h"
+#include "levels.h"
+#include "zobrist.h"
+#include "undo.h"
+#include "save.h"
+#include "search.h"
+#include "distance.h"
+#include "mcts.h"
+#include "chunks.h"
+
 using namespace std;
 
 struct VAO {
@@ -200,6 +211,27 @@ void draw3DObject (struct VAO* vao)
   glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
 }
 
+/* Render count vertices of the VBOs handled by VAO, from vertex first on */
+void draw3DObject (struct VAO* vao, int first, int count)
+{
+  glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
+  glBindVertexArray (vao->VertexArrayID);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
+  glDrawArrays(vao->PrimitiveMode, first, count);
+}
+
+/* Free the VAO and its VBOs */
+void delete3DObject (struct VAO* vao)
+{
+  glDeleteBuffers (1, &(vao->VertexBuffer));
+  glDeleteBuffers (1, &(vao->ColorBuffer));
+  glDeleteVertexArrays (1, &(vao->VertexArrayID));
+  delete vao;
+}
+
 /**************************
  * Customizable functions *
  **************************/
@@ -221,63 +253,88 @@ typedef struct object_type
   VAO * coordinates;
 }object_type;
 
-object_type block,board_pieces[10][10],cam;
+object_type block,cam;
+float board_x0,board_z0;                 // where the centre of tile (0,0) is drawn
+
+// the board is drawn a chunk at a time, see chunks.h: the chunks within
+// CHUNK_DRAW_RADIUS of the one the camera looks at, built a little further
+// out so they are ready before they come into view, and at most
+// CHUNK_UPLOADS a frame sent to the GPU. On a board bigger than a chunk the
+// camera follows the block.
+#define CHUNK_DRAW_RADIUS 2
+#define CHUNK_STREAM_RADIUS 3
+#define CHUNK_UPLOADS 4
+chunk_cache chunks;
+glm::vec3 look;     // where the camera looks
+int look_snap=1;    // jump there instead of gliding, as a level starts
+int look_cx,look_cz;
 
-int no_of_moves=0;
 int level=1;
-int switch_check=0;
-int x_check=-1;
-int z_check=-1;
-int x1_check=-1;
-int z1_check=-1;
-int game_check=0;
+int game_check=0;   // 1 level cleared, -1 just fell, -2 fall announced
 int v_eye[]={4,4,6};
 
-int board[10][10];
-int board_1[10][10]={
-  //0 1 2 3 4 5 6 7 8 9
-  { 1,1,1,1,1,1,0,0,0,0}, //0
-  { 1,1,1,1,1,1,0,0,6,0},//1
-  { 1,1,0,0,1,1,0,0,1,0}, //2
-  { 1,1,0,0,1,1,1,1,1,0},//3
-  { 1,1,0,0,0,1,0,1,1,1}, //4
-  { 1,1,0,0,0,1,0,1,1,1}, //5
-  { 1,1,0,0,0,0,0,1,1,1} ,//6
-  { 1,1,0,0,0,0,0,1,1,0} ,//7
-  { 1,1,1,1,1,1,1,1,1,0} ,//8
-  { 1,1,1,1,1,1,1,1,1,0} //9
-};
-
-int board_2[10][10]={
-  //0 1 2 3 4 5 6 7 8 9
-  {0,0,0,0,0,0,0,0,0,0}, //0
-  {0,1,1,1,1,1,1,0,6,0}, //1
-  {0,1,1,1,1,1,1,0,1,0}, //2
-  {1,1,1,0,0,3,0,1,1,1}, //3
-  {1,1,1,0,0,3,0,1,1,1}, //4
-  {1,1,1,0,0,1,0,1,1,1}, //5
-  {0,1,1,0,0,1,0,1,1,1}, //6
-  {0,1,1,0,0,4,0,1,1,1}, //7
-  {0,1,1,1,1,1,1,1,1,0}, //8
-  {0,1,1,1,1,1,1,1,1,0} //9
-};
-
-
-int board_3[10][10]={
-  //0 1 2 3 4 5 6 7 8 9
-  {0,0,0,1,1,1,0,0,0,0},//0
-  {0,0,1,1,1,1,0,0,6,0},//1
-  {1,1,1,1,1,1,0,0,1,0},//2
-  {2,2,1,0,0,3,0,1,1,0},//3
-  {1,1,1,0,0,3,0,1,1,0},//4
-  {0,1,1,0,0,1,0,1,1,0},//5
-  {1,1,1,0,0,4,0,1,1,0},//6
-  {2,2,1,1,1,1,1,1,1,0},//7
-  {1,1,1,1,1,1,1,1,1,1},//8
-  {0,0,0,1,1,0,0,0,0,0}
-};
-
+std::vector<level_def> pack;   // the levels played: built in, or a text --levels pack
+level_pack_map packed;         // or a binary --levels pack, mapped
+level_def mapped_level;        // the level of it being played
+int builtin_levels=0;          // pack holds the built-in levels, loaded from their fixed-size boards
+level_def *current_level;
+level_board current_board;
+game_state state;
+undo_ring history;
+
+// tiles drawn this frame: retracted bridges, broken crumble tiles and timed
+// tiles away this tick are not. A roll only flips the timed tiles that come
+// or go on the tick it reaches; a switch, a crumble or a jump of more than
+// one tick refreshes every tile.
+std::vector<unsigned char> shown;   // [x*height+z]
+game_state shown_for;
+std::vector<int> tick_changes[MAX_PERIOD];   // cells i*height+j flipped on reaching each tick
+int history_request=0;   // -1 undo, 1 redo, done by draw() between rolls
+const char *save_path=NULL;   // --save checkpoint, rewritten after every roll
+int resumed=0;
+
+// H asks for a hint: a lookup in the level's distance table once its
+// background build is done, until then an A* search from the current state,
+// run a slice at a time so a frame never spends more than HINT_FRAME_TIME
+// on it
+#define HINT_STATES 65536
+#define HINT_FRAME_TIME 0.0015
+astar_search hint;
+int hint_request=0;
+int hint_running=0;
+game_state hint_from;
+distance_table distances;
+
+// B hands the arrow keys to the Monte Carlo bot, which picks each roll
+// with BOT_ROLLOUTS rollouts once the block is still, off the render thread
+#define BOT_ROLLOUTS 4000
+#define BOT_NODES 65536
+#define BOT_DEPTH 64
+mcts_bot bot;
+int bot_playing=0;
+
+// determinism checking: the hash of state and the moves played so far
+zobrist_keys keys;
+uint64_t current_hash;
+std::vector<hash_entry> hash_session;
+std::vector<hash_entry> hash_reference;  // --check stream
+FILE *hash_record=NULL;                  // --record stream
+int hash_checking=0;
+long hash_mismatch=-1;
+
+/* Start rolling the block in direction dir; draw() animates the roll and
+   step() resolves it once the block is over */
+void startRoll(int dir)
+{
+  static const int rotate_checks[NUM_DIRS]={-1,1,2,-2};
+  static const glm::vec3 rotate_vectors[NUM_DIRS]={
+    glm::vec3(0,0,1),glm::vec3(0,0,-1),glm::vec3(-1,0,0),glm::vec3(1,0,0)
+  };
 
+  block.rotate_check=rotate_checks[dir];
+  block.rotate_vector=rotate_vectors[dir];
+  block.rotate=0;
+}
 
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
@@ -298,25 +355,30 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
       case GLFW_KEY_X:
         // do something ..
         break;
+      case GLFW_KEY_Z:
+        history_request=-1;
+        break;
+      case GLFW_KEY_Y:
+        history_request=1;
+        break;
+      case GLFW_KEY_H:
+        hint_request=1;
+        break;
+      case GLFW_KEY_B:
+        bot_playing=!bot_playing;
+        printf(bot_playing ? "Bot playing, press B to take over\n" : "Bot stopped\n");
+        break;
       case GLFW_KEY_LEFT:
-        block.rotate_check=-1;
-        block.rotate_vector= glm :: vec3(0,0,1);
-        block.rotate=0;
+        startRoll(DIR_LEFT);
         break;
       case GLFW_KEY_RIGHT:
-        block.rotate_check=1;
-        block.rotate_vector= glm :: vec3(0,0,-1);
-        block.rotate=0;
+        startRoll(DIR_RIGHT);
         break;
       case GLFW_KEY_UP:
-        block.rotate_check=2;
-        block.rotate_vector= glm :: vec3(-1,0,0);
-        block.rotate=0;
+        startRoll(DIR_UP);
         break;
       case GLFW_KEY_DOWN:
-        block.rotate_check=-2;
-        block.rotate_vector= glm :: vec3(1,0,0);
-        block.rotate=0;
+        startRoll(DIR_DOWN);
         break;
       case GLFW_KEY_D:
         v_eye[0]=4;
@@ -619,349 +681,401 @@ void createblock(float x, float y,float z, float l ,float h, float b,float c1, f
   block.rotate_vector= glm :: vec3(0,0,1);
 }
 
+VAO *block_shapes[3];   // the block's VAO in each orientation
+
+/* Size of the block along x, y and z in orientation o */
+void blockSize(int o,float *l,float *h,float *b)
+{
+  *l=(o==ORIENT_LYING_X) ? 1 : 0.5;
+  *h=(o==ORIENT_STANDING) ? 1 : 0.5;
+  *b=(o==ORIENT_LYING_Z) ? 1 : 0.5;
+}
 
-VAO * createPiece(float a,int type)
+/* Build the block once per orientation, so rolling, undoing and redoing
+   only pick a VAO and move it */
+void createBlockShapes()
 {
+  float l,h,b;
+  int o;
 
-  GLfloat vertex_buffer_data[] =
+  for(o=0;o<3;o++)
   {
+    blockSize(o,&l,&h,&b);
+    createblock(0,0,0,l,h,b,1,1,1);
+    block_shapes[o]=block.coordinates;
+  }
+}
 
-    -a/2,-a/4,a/2,   //1
-    a/2,-a/4,a/2,     //2
-    a/2,a/4,a/2,     //5
-    a/2,a/4,a/2,     //5
-    -a/2,a/4,a/2,     //6
-    -a/2,-a/4,a/2,   //1
-
-
-    a/2,-a/4,a/2,     //2
-    a/2,-a/4,-a/2,     //3
-    a/2,a/4,-a/2,     //8
-    a/2,a/4,-a/2,     //8
-    a/2,a/4,a/2,     //5
-    a/2,-a/4,a/2,     //2
-
-    a/2,a/4,-a/2,     //8
-    -a/2,a/4,-a/2,     //7
-    -a/2,-a/4,-a/2,     //4
-    -a/2,-a/4,-a/2,     //4
-    a/2,-a/4,-a/2,     //3
-    a/2,a/4,-a/2,     //8
-
-    -a/2,a/4,-a/2,     //7
-    -a/2,a/4,a/2,     //6
-    -a/2,-a/4,a/2,   //1
-    -a/2,-a/4,a/2,   //1
-    -a/2,-a/4,-a/2,     //4
-    -a/2,a/4,-a/2,     //7
-
-
-    -a/2,-a/4,a/2,   //1
-    a/2,-a/4,a/2,     //2
-    a/2,-a/4,-a/2,     //3
-    a/2,-a/4,-a/2,     //3
-    -a/2,-a/4,-a/2,     //4
-    -a/2,-a/4,a/2,   //1
-
-
-    -a/2,a/4,a/2,     //6
-    a/2,a/4,a/2,     //5
-    a/2,a/4,-a/2,     //8
-    a/2,a/4,-a/2,     //8
-    -a/2,a/4,-a/2,     //7
-    -a/2,a/4,a/2     //6
+/* Place the render block where the packed rules state says. Cell (x,z) is
+   the tile centred at (-2.5+0.5*x, 2.5-0.5*z); a lying block sits 0.25
+   lower. */
+void createBlockFromState()
+{
+  int o=block_orient(state.block);
+  float l,h,b;
 
-  };
+  blockSize(o,&l,&h,&b);
+  block.coordinates=block_shapes[o];
+  block.center=glm :: vec3(board_x0+0.5*block_x(state.block)+(l-0.5)/2,(h-1)/2,board_z0-0.5*block_z(state.block)-(b-0.5)/2);
+  block.length=l;
+  block.height=h;
+  block.width=b;
+  block.rotate_vector=glm :: vec3(0,0,1);
+}
+
+
+int levelCount()
+{
+  return packed.base ? packed.levels : (int)pack.size();
+}
+
+uint64_t packId()
+{
+  return packed.base ? packed.pack_id : level_pack_id(pack);
+}
+
+/* Upload a chunk the builder finished and free its copy of the mesh */
+void uploadChunk(chunk_slot *slot)
+{
+  chunk_mesh *m=&slot->mesh;
+
+  if(!m->vertices.empty())
+    slot->gpu=create3DObject(GL_TRIANGLES,m->vertices.size()/3,&m->vertices[0],&m->colours[0],GL_FILL);
+  std::vector<float>().swap(m->vertices);
+  std::vector<float>().swap(m->colours);
+}
+
+void freeChunks(const std::vector<void *> &freed)
+{
+  size_t k;
+
+  for(k=0;k<freed.size();k++)
+    delete3DObject((VAO *)freed[k]);
+}
+
+void createBoard()
+{
   int i;
-  if(type==1)
+  int j;
+  std::vector<void *> freed;
+  stop_chunks(&chunks,&freed);
+  freeChunks(freed);
+  // a decision still running reads the board about to be replaced
+  mcts_stop(&bot);
+  // a binary pack's levels are read from the mapping only when played,
+  // their tiles unpacked straight into current_board; the tiles are drawn
+  // from there whatever the level came from
+  if(packed.base)
   {
-    GLfloat color_buffer_data[]=
+    int ok=load_mapped_level(&current_board,&packed,level-1,&mapped_level);
+    // one packed without its layout needs its tiles to work it out
+    if(ok && !mapped_level.laid_out)
     {
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      1,0,0,
-      0,0,0,
-      1,0,0,
-      1,0,0,
-      0,0,0,
-      1,0,0,
-
-      1,0,0,
-      0,0,0,
-      1,0,0,
-      1,0,0,
-      0,0,0,
-      1,0,0
-    };
-    return create3DObject(GL_TRIANGLES,6*2*3,vertex_buffer_data,color_buffer_data,GL_FILL);
+      ok=read_mapped_level(&packed,level-1,&mapped_level);
+      lay_out_level(&mapped_level);
+    }
+    if(!ok)
+    {
+      printf("Level %d: %s\n",level,level_pack_error(LEVEL_PACK_DAMAGED));
+      exit(1);
+    }
+    current_level=&mapped_level;
   }
-  else if(type==6)
+  else
   {
-    GLfloat color_buffer_data[]=
-    {
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-      0.6,0,0,
-
-      0,0,0,
-      0,0,0,
-      0,0,0,
-      0,0,0,
-      0,0,0,
-      0,0,0,
-
-      0,0,0,
-      0,0,0,
-      0,0,0,
-      0,0,0,
-      0,0,0,
-      0,0,0
-    };
-    return create3DObject(GL_TRIANGLES,6*2*3,vertex_buffer_data,color_buffer_data,GL_FILL);
+    current_level=&pack[level-1];
+    lay_out_level(current_level);
+    if(builtin_levels)
+      load_board(&current_board,*builtin_level(level));
+    else
+      load_level(&current_board,current_level);
   }
-  else if(type==4)
+  init_zobrist(&keys,&current_board);
+  start_distances(&distances,&current_board);
+  mcts_init(&bot,&current_board,std::thread::hardware_concurrency(),BOT_NODES,BOT_DEPTH);
+
+  // the built-in levels where they always were, tile (0,0) at
+  // (-2.5,2.5), which centres the whole 10x10 board on the origin
+  // whatever tiles it has; other levels have their tiles' bounding box
+  // centred there
+  if(builtin_levels)
   {
-    GLfloat color_buffer_data[]=
-    {
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-      0,0.6,0,
-
-      0.2,1,0.2,
-      0,0,0,
-      0.2,1,0.2,
-      0.2,1,0.2,
-      0,0,0,
-      0.2,1,0.2,
-
-      0.2,1,0.2,
-      0,0,0,
-      0.2,1,0.2,
-      0.2,1,0.2,
-      0,0,0,
-      0.2,1,0.2,
-
-    };
-    return create3DObject(GL_TRIANGLES,6*2*3,vertex_buffer_data,color_buffer_data,GL_FILL);
+    board_x0=-0.25*current_board.width;
+    board_z0=0.25*current_board.height;
   }
-  else if(type==3)
+  else
   {
-    GLfloat color_buffer_data[]=
-    {
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-      0,0,0.6,
-
-      0.2,0.2,1,
-      0,0,0,
-      0.2,0.2,1,
-      0.2,0.2,1,
-      0,0,0,
-      0.2,0.2,1,
-
-      0.2,0.2,1,
-      0,0,0,
-      0.2,0.2,1,
-      0.2,0.2,1,
-      0,0,0,
-      0.2,0.2,1,
-
-    };
-    return create3DObject(GL_TRIANGLES,6*2*3,vertex_buffer_data,color_buffer_data,GL_FILL);
+    board_x0=-0.25*(current_level->min_x+current_level->max_x+1);
+    board_z0=0.25*(current_level->min_z+current_level->max_z+1);
   }
-  else if(type==2)
+  shown.assign(current_board.width*current_board.height,0);
+  start_chunks(&chunks,&current_board,board_x0,board_z0);
+  look_snap=1;
+
+  int t;
+  for(t=0;t<MAX_PERIOD;t++)
+    tick_changes[t].clear();
+  for(i=0;i<current_board.width;i++)
   {
-    GLfloat color_buffer_data[]=
+    for(j=0;j<current_board.height;j++)
     {
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-      0.5,0.5,0.5,
-
-      0.9,0.9,0.9,
-      0,0,0,
-      0.9,0.9,0.9,
-      0.9,0.9,0.9,
-      0,0,0,
-      0.9,0.9,0.9,
-
-      0.9,0.9,0.9,
-      0,0,0,
-      0.9,0.9,0.9,
-      0.9,0.9,0.9,
-      0,0,0,
-      0.9,0.9,0.9,
-
-    };
-    return create3DObject(GL_TRIANGLES,6*2*3,vertex_buffer_data,color_buffer_data,GL_FILL);
+      if(tile_at(&current_board,i,j)!=TILE_TIMED)
+        continue;
+      uint32_t on=current_board.present[cell_index(&current_board,i,j)];
+      int period=current_board.period;
+      for(t=0;t<period;t++)
+        if(((on>>t)^(on>>((t+period-1)%period)))&1)
+          tick_changes[t].push_back(i*current_board.height+j);
+    }
   }
+}
+
+/* Work out every tile's visibility from scratch */
+void showAllTiles()
+{
+  const level_board *b=&current_board;
+  int i,j;
 
+  for(i=0;i<b->width;i++)
+    for(j=0;j<b->height;j++)
+      shown[i*b->height+j]=(tile_at(b,i,j)!=TILE_VOID) && tile_present(b,&state,i,j);
+  shown_for=state;
 }
 
-void createBoard()
+/* Bring shown[] up to date after a roll, undo or redo */
+void showTiles()
 {
-  int i;
-  int j;
-  if(level==1)
+  int period=current_board.period;
+  uint32_t flip;
+  size_t k;
+
+  if(state.damage!=shown_for.damage)
   {
-    for(i=0;i<10;i++)
-      for(j=0;j<10;j++)
-        board[i][j]=board_1[i][j];
+    showAllTiles();
+    return;
   }
-  else if(level==2)
+  // a switch only moves the bridges linked to it
+  if(state.switch_check!=shown_for.switch_check)
   {
-    for(i=0;i<10;i++)
-      for(j=0;j<10;j++)
-        board[i][j]=board_2[i][j];
+    uint32_t changed=state.switch_check^shown_for.switch_check;
+    int height=current_board.height;
+    for(k=0;k<current_level->links.size();k++)
+    {
+      const level_link *e=&current_level->links[k];
+      if((changed>>current_board.group[cell_index(&current_board,e->x,e->z)])&1)
+        shown[e->bridge_x*height+e->bridge_z]=tile_present(&current_board,&state,e->bridge_x,e->bridge_z);
+    }
+    shown_for.switch_check=state.switch_check;
   }
-  else if(level==3)
+  // the tiles that change between two ticks are the same either way round
+  if(state.tick==(shown_for.tick+1)%period)
+    flip=state.tick;
+  else if(shown_for.tick==(state.tick+1)%period)
+    flip=shown_for.tick;
+  else
   {
-    for(i=0;i<10;i++)
-      for(j=0;j<10;j++)
-        board[i][j]=board_3[i][j];
+    if(state.tick!=shown_for.tick)
+      showAllTiles();
+    return;
   }
+  for(k=0;k<tick_changes[flip].size();k++)
+    shown[tick_changes[flip][k]]^=1;
+  shown_for=state;
+}
+
+
+
+/* Hash the move just played and log it to the --record stream, comparing
+   it with the --check stream as we go */
+void recordMove(const game_state *before,int dir)
+{
+  hash_entry e;
 
+  current_hash=zobrist_update(&keys,&current_board,current_hash,before,&state);
+  e.level=level;
+  e.dir=dir;
+  e.hash=current_hash;
+  hash_session.push_back(e);
 
-  for(i=0;i<10;i++)
+  if(hash_record)
+  {
+    write_hash_entry(hash_record,&e);
+    fflush(hash_record);
+  }
+  if(hash_checking && hash_mismatch<0)
   {
-    for(j=0;j<10;j++)
+    long n=hash_session.size()-1;
+    const hash_entry *r=(n<(long)hash_reference.size()) ? &hash_reference[n] : NULL;
+    if(!r || r->level!=e.level || r->dir!=e.dir || r->hash!=e.hash)
     {
-      if(board[i][j]!=0)
-      {
-        board_pieces[i][j].coordinates=createPiece(0.5,board[i][j]);
-        board_pieces[i][j].center=glm :: vec3(-2.5+i*0.5,-0.5-0.125,2.5-j*0.5);
-      }
+      hash_mismatch=n;
+      printf("Hash check: first divergent move %ld\n",n+1);
     }
   }
 }
 
+/* Checkpoint the session to the --save file. A fall isn't saved, so
+   resuming after one starts from the roll before it. */
+void checkpoint()
+{
+  if(!save_path || game_check<0)
+    return;
+  // a finished game starts over next time
+  if(level>levelCount())
+  {
+    remove(save_path);
+    return;
+  }
+  int status=save_game(save_path,packId(),level,&state);
+  if(status!=SAVE_OK)
+    printf("Cannot save to %s: %s\n",save_path,save_error(status));
+}
 
+/* Say so as soon as the block is somewhere the goal can't be reached from */
+void checkDeadEnd()
+{
+  if(distance_to_goal(&distances,&state)==DIST_DEAD)
+    printf("No way to the goal from here, press Z to undo\n");
+}
+
+/* Undo (way -1) or redo (way 1) a roll. Undoing a fall puts the block back
+   where it stood before the roll. */
+void stepHistory(int way)
+{
+  game_state before=state;
+
+  if(!undo_step(&history,&state,way,game_check<0))
+    return;
+  game_check=0;
+  showTiles();
+  recordMove(&before,(way<0) ? HASH_UNDO : HASH_REDO);
+  printf("Score:%d\n",state.no_of_moves);
+  createBlockFromState();
+  checkpoint();
+  checkDeadEnd();
+}
+
+/* Carry the hint search on for this frame's share of time, and print the
+   roll to make once it is found. A roll or undo since it started makes it
+   stale, so it is dropped. */
+void stepHint()
+{
+  static const char *roll_names[NUM_DIRS]={"Left","Right","Up","Down"};
+
+  // from the start of a compiled level its solution answers at once
+  game_state start;
+  start_level(&start,current_level);
+  if(hint_request && game_check==0 && current_level->compiled && current_level->par>0 && same_state(&start,&state))
+  {
+    printf("Hint: %s, %d moves to go\n",roll_names[current_level->solution[0]],current_level->par);
+    hint_request=0;
+    hint_running=0;
+  }
+  if(hint_request && game_check==0 && distance_to_goal(&distances,&state)>=0)
+  {
+    int dir=best_roll(&distances,&state);
+    if(dir<0)
+      printf("Hint: the goal can't be reached from here, press Z to undo\n");
+    else
+      printf("Hint: %s, %d moves to go\n",roll_names[dir],distance_to_goal(&distances,&state));
+    hint_request=0;
+    hint_running=0;
+  }
+  if(hint_request && game_check==0)
+  {
+    astar_start(&hint,&current_board,&state,HINT_STATES);
+    hint_from=state;
+    hint_running=1;
+  }
+  hint_request=0;
+  if(!hint_running)
+    return;
+  if(game_check!=0 || !same_state(&hint_from,&state))
+  {
+    hint_running=0;
+    return;
+  }
+
+  double stop=glfwGetTime()+HINT_FRAME_TIME;
+  while(!astar_run(&hint,256) && glfwGetTime()<stop)
+    ;
+  if(!hint.done)
+    return;
+  hint_running=0;
+  if(hint.moves>0)
+    printf("Hint: %s, %d moves to go\n",roll_names[hint.path[0]],hint.moves);
+  else if(hint.full)
+    printf("Hint: too far from the goal to tell\n");
+  else
+    printf("Hint: the goal can't be reached from here, press Z to undo\n");
+}
+
+/* While the bot is playing, start a decision once the block is still and
+   start the roll it comes back with as the arrow keys do, if the block is
+   still where it was asked about, and report the rollout rate every so
+   often */
+void stepBot()
+{
+  static double last_report=0;
+  static game_state asked;
+
+  int dir=mcts_poll(&bot);
+  if(dir==MCTS_THINKING)
+    return;
+  if(!bot_playing || game_check!=0 || block.rotate_check!=0 || history_request!=0)
+    return;
+  if(dir==MCTS_IDLE || state_hash(&asked)!=state_hash(&state))
+  {
+    asked=state;
+    mcts_start(&bot,&state,BOT_ROLLOUTS);
+    return;
+  }
+  if(dir<0)
+  {
+    printf("Bot: every roll falls from here, or there is no goal\n");
+    bot_playing=0;
+    return;
+  }
+  startRoll(dir);
+  if(glfwGetTime()-last_report>=1)
+  {
+    printf("Bot: %.2fM rollouts/s\n",bot.rollouts_per_second/1e6);
+    last_report=glfwGetTime();
+  }
+}
+
+/* Move the camera towards where it looks, and keep the chunks around
+   there built and uploaded */
+void streamChunks()
+{
+  const level_def *l=current_level;
+  glm::vec3 target(0,0,0);
+  std::vector<void *> freed;
+  chunk_slot *slot;
+  int n;
+
+  if(l->max_x-l->min_x>=CHUNK_SIZE || l->max_z-l->min_z>=CHUNK_SIZE)
+    target=glm::vec3(block.center.x,0,block.center.z);
+  look=look_snap ? target : look+(target-look)*0.1f;
+  look_snap=0;
+  // floored both times, so a look point off the low edge of the board is
+  // in chunk -1 rather than rounded into chunk 0
+  look_cx=(int)floorf(floorf((look.x-board_x0)/0.5f+0.5f)/CHUNK_SIZE);
+  look_cz=(int)floorf(floorf((board_z0-look.z)/0.5f+0.5f)/CHUNK_SIZE);
+
+  want_chunks(&chunks,look_cx,look_cz,CHUNK_STREAM_RADIUS,&freed);
+  freeChunks(freed);
+  for(n=0;n<CHUNK_UPLOADS && (slot=built_chunk(&chunks));n++)
+    uploadChunk(slot);
+  // the chunk in the middle of the view is never left out
+  slot=wait_chunk(&chunks,look_cx,look_cz);
+  if(slot)
+    uploadChunk(slot);
+}
 
 float camera_rotation_angle = 90;
 float rectangle_rotation = 0;
 float triangle_rotation = 0;
-int base_check=1;
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
 void draw ()
@@ -973,6 +1087,8 @@ void draw ()
   // Don't change unless you know what you are doing
   glUseProgram (programID);
 
+  streamChunks();
+
   // Eye - Location of camera. Don't change unless you are sure!!
   glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
   // Target - Where is the camera looking at.  Don't change unless you are sure!!
@@ -983,7 +1099,7 @@ void draw ()
   // Compute Camera matrix (view)
   // Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
   //  Don't change unless you are sure!!
-  Matrices.view = glm::lookAt(glm::vec3(v_eye[0],v_eye[1],v_eye[2]), glm::vec3(0,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
+  Matrices.view = glm::lookAt(glm::vec3(v_eye[0],v_eye[1],v_eye[2])+look, look, glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
   //  Matrices.view = glm::lookAt(eye,target,glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
 
   // Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
@@ -1000,7 +1116,16 @@ void draw ()
 
   /* Render your scene */
 
-  int i=0;
+  // a fallen block can only be undone
+  if(game_check<0)
+    block.rotate_check=0;
+  if(history_request!=0 && block.rotate_check==0)
+  {
+    stepHistory(history_request);
+    history_request=0;
+  }
+  stepHint();
+  stepBot();
 
   if(block.rotate_check==0 && game_check>-1)
   {
@@ -1087,635 +1212,84 @@ void draw ()
   {
     block.rotate=block.rotate+5*2;
   }
-  else
+  else if(block.rotate_check!=0)
   {
-    //change coordinates
-    if(block.rotate_check==-1)
-    {
-      block.center[0]=block.center[0]-block.length/2-block.height/2;
-      if(block.length!=block.height)
-        block.center[1]=block.center[1]-(0.25)*base_check;
-      block.height=block.length- block.height;
-      block.length=block.length -block.height;
-      block.height=block.height+ block.length;
-      if(block.height!=1)
-        base_check=-1;
-      else
-        base_check=1;
-      block.rotate_check=0;
-      block.rotate=0;
-      if(block.height==1)
-      {
-        x_check=(block.center[0]+2.5)/0.5;
-        z_check=(-block.center[2]+2.5)/0.5;
-
-        if(board[x_check][z_check]==0 || board[x_check][z_check]==2)
-        {
-          no_of_moves++;
-          game_check=-1;
-          printf("Game Over\n");
-          printf("%d %d\n",x_check,z_check);
-          printf("You Lost\n");
-          // kill_bloc();
-          printf("End_Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==6)
-        {
-          game_check=1;
-          level++;
-          system("play stage_clear.wav");
-          no_of_moves++;
-          //show display
-          printf("End_Score:%d\n",no_of_moves);
-          printf("Next_Level:%d\n",level);
-          // createBoard();
-        }
-        else if(board[x_check][z_check]==4)
-        {
-          if(switch_check==0)
-            switch_check=1;
-          else if (switch_check==1)
-            switch_check=0;
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==1)
-        {
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-      }
-      if(block.height==0.5)
-      {
-        if(block.length==1)
-        {
-          x_check=(block.center[0]+0.25+2.5)/0.5;
-          z_check=(-block.center[2]+2.5)/0.5;
-          x1_check=(block.center[0]-0.25+2.5)/0.5;
-          z1_check=(-block.center[2]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-            // printf("lenght:%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-            printf("You Lost!!\n");
-            printf("End_Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              //  printf("lenght:%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-        if(block.width==1)
-        {
-          z_check=(-block.center[2]+0.25+2.5)/0.5;
-          x_check=(block.center[0]+2.5)/0.5;
-          z1_check=(-block.center[2]-0.25+2.5)/0.5;
-          x1_check=(block.center[0]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-            // printf("width:%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-            printf("You Lost\n");
-          }
-          else if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              //  printf("lenght:%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-      }
-      createblock(block.center[0],block.center[1],block.center[2],block.length,block.height,block.width,1,1,1);
-      //  printf("new_rotate:%f\n",block.rotate);                      
-    }
-    if(block.rotate_check==1)
+    // the rules decide what the block landed on
+    game_state before=state;
+    int dir=dir_from_rotate_check(block.rotate_check);
+    int outcome=step(&current_board,&state,dir);
+    showTiles();
+    recordMove(&before,dir);
+    undo_record(&history,&state,outcome);
+    block.rotate_check=0;
+    block.rotate=0;
+
+    if(outcome==MOVE_FALL)
     {
-      //    printf("length,height:%f %f\n",block.length,block.height);                      
-      //   printf("rotate:%f\n",block.rotate);                      
-      block.center[0]=block.center[0]+block.length/2+block.height/2;
-      if(block.length!=block.height)
-        block.center[1]=block.center[1]-(0.25)*base_check;
-      //  printf("center_right: %.2f %.2f %.2f\n",block.center[0],block.center[1],block.center[2]);
-      block.height=block.length- block.height;
-      block.length=block.length -block.height;
-      block.height=block.height+ block.length;
-      // printf("new l,h,b:%f %f %f\n",block.length,block.height,block.width);                      
-      if(block.height!=1)
-        base_check=-1;
-      else
-        base_check=1;
-      block.rotate_check=0;
-      block.rotate=0;
-      if(block.height==1)
-      {
-        x_check=(block.center[0]+2.5)/0.5;
-        z_check=(-block.center[2]+2.5)/0.5;
-
-        if(board[x_check][z_check]==0 || board[x_check][z_check]==2)
-        {
-          no_of_moves++;
-          game_check=-1;
-          printf("Game Over\n");
-          //  printf("%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-          printf("You Lost\n");
-          printf("End_Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==6)
-        {
-          game_check=1;
-          level++;
-          system("play stage_clear.wav");
-          no_of_moves++;
-          //show display
-          printf("End_Score:%d\n",no_of_moves);
-          printf("Next_Level:%d\n",level);
-          // createBoard();
-        }
-        else if(board[x_check][z_check]==1)
-        {
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==4)
-        {
-          if(switch_check==0)
-            switch_check=1;
-          else if (switch_check==1)
-            switch_check=0;
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-      }
-      if(block.height==0.5)
-      {
-        if(block.length==1)
-        {
-          x_check=(block.center[0]+0.25+2.5)/0.5;
-          z_check=(-block.center[2]+2.5)/0.5;
-          x1_check=(block.center[0]-0.25+2.5)/0.5;
-          z1_check=(-block.center[2]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-            // printf("%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-            printf("You Lost\n");
-            printf("End_Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              // printf("lenght:%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-        if(block.width==1)
-        {
-          z_check=(-block.center[2]+0.25+2.5)/0.5;
-          x_check=(block.center[0]+2.5)/0.5;
-          z1_check=(-block.center[2]-0.25+2.5)/0.5;
-          x1_check=(block.center[0]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-            // printf("%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-            printf("You Lost\n");
-          }
-          if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              // printf("lenght:%d %d %d %d\n",x_check,z_check,x1_check,z1_check);
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-      }
-      createblock(block.center[0],block.center[1],block.center[2],block.length,block.height,block.width,1,1,1);
+      game_check=-1;
+      printf("Game Over\n");
+      printf("You Lost\n");
+      printf("End_Score:%d\n",state.no_of_moves);
     }
-    if(block.rotate_check==2)
+    else if(outcome==MOVE_GOAL)
     {
-      //    printf("length,height:%f %f\n",block.length,block.height);                      
-      //   printf("rotate:%f\n",block.rotate);                      
-      block.center[2]=block.center[2]-block.width/2-block.height/2;
-      if(block.width!=block.height)
-        block.center[1]=block.center[1]-(0.25)*base_check;
-      //  printf("center_up: %.2f %.2f %.2f\n",block.center[0],block.center[1],block.center[2]);
-      block.height=block.width- block.height;
-      block.width=block.width -block.height;
-      block.height=block.height+ block.width;
-      //  printf("new l,h,b:%f %f %f\n",block.length,block.height,block.width);                      
-      if(block.height!=1)
-        base_check=-1;
-      else
-        base_check=1;
-      block.rotate_check=0;
-      block.rotate=0;
-      if(block.height==1)
-      {
-        x_check=(block.center[0]+2.5)/0.5;
-        z_check=(-block.center[2]+2.5)/0.5;
-
-        if(board[x_check][z_check]==0 || board[x_check][z_check]==2)
-        {
-          no_of_moves++;
-          game_check=-1;
-          printf("Game Over\n");
-          printf("You Lost\n");
-          printf("End_Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==6)
-        {
-          game_check=1;
-          level++;
-          system("play stage_clear.wav");
-          no_of_moves++;
-          //show display
-          printf("End_Score:%d\n",no_of_moves);
-          printf("Next_Level:%d\n",level);
-          //createBoard();
-        }
-        else if(board[x_check][z_check]==1)
-        {
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==4 )
-        {
-          if(switch_check==0)
-            switch_check=1;
-          else if (switch_check==1)
-            switch_check=0;
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-      }
-      if(block.height==0.5)
-      {
-        if(block.length==1)
-        {
-          x_check=(block.center[0]+0.25+2.5)/0.5;
-          z_check=(-block.center[2]+2.5)/0.5;
-          x1_check=(block.center[0]-0.25+2.5)/0.5;
-          z1_check=(-block.center[2]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-            printf("You Lost\n");
-            printf("End_Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-        if(block.width==1)
-        {
-          z_check=(-block.center[2]+0.25+2.5)/0.5;
-          x_check=(block.center[0]+2.5)/0.5;
-          z1_check=(-block.center[2]-0.25+2.5)/0.5;
-          x1_check=(block.center[0]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-            printf("You Lost\n");
-          }
-          else if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-      }
-      createblock(block.center[0],block.center[1],block.center[2],block.length,block.height,block.width,1,1,1);
+      game_check=1;
+      level++;
+      system("play stage_clear.wav");
+      //show display
+      printf("End_Score:%d\n",state.no_of_moves);
+      if(current_level->par>=0)
+        printf("Par:%d\n",current_level->par);
+      printf("Next_Level:%d\n",level);
+      // that was the last level: main() ends the game, and the snapshot goes
+      if(level>levelCount())
+        checkpoint();
     }
-    if(block.rotate_check==-2)
+    else
     {
-      //    printf("length,height:%f %f\n",block.length,block.height);                      
-      //   printf("rotate:%f\n",block.rotate);                      
-      block.center[2]=block.center[2]+block.width/2+block.height/2;
-      if(block.width!=block.height)
-        block.center[1]=block.center[1]-(0.25)*base_check;
-      block.height=block.width- block.height;
-      block.width=block.width -block.height;
-      block.height=block.height+ block.width;
-      if(block.height!=1)
-        base_check=-1;
-      else
-        base_check=1;
-      block.rotate_check=0;
-      block.rotate=0;
-      if(block.height==1)
-      {
-        x_check=(block.center[0]+2.5)/0.5;
-        z_check=(-block.center[2]+2.5)/0.5;
-
-        if(board[x_check][z_check]==0 || board[x_check][z_check]==2)
-        {
-          no_of_moves++;
-          game_check=-1;
-          printf("Game Over\n");
-          printf("End_Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==6)
-        {
-          game_check=1;
-          level++;
-          system("play stage_clear.wav");
-          no_of_moves++;
-          //show display
-          printf("End_Score:%d\n",no_of_moves);
-          printf("Next_Level:%d\n",level);
-          // createBoard();
-        }
-        else if(board[x_check][z_check]==4)
-        {
-          if(switch_check==0)
-            switch_check=1;
-          else if (switch_check==1)
-            switch_check=0;
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-        else if(board[x_check][z_check]==1)
-        {
-          no_of_moves++;
-          printf("Score:%d\n",no_of_moves);
-        }
-      }
-      if(block.height==0.5)
-      {
-        if(block.length==1)
-        {
-          x_check=(block.center[0]+0.25+2.5)/0.5;
-          z_check=(-block.center[2]+2.5)/0.5;
-          x1_check=(block.center[0]-0.25+2.5)/0.5;
-          z1_check=(-block.center[2]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-            printf("End_Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-        if(block.width==1)
-        {
-          z_check=(-block.center[2]+0.25+2.5)/0.5;
-          x_check=(block.center[0]+2.5)/0.5;
-          z1_check=(-block.center[2]-0.25+2.5)/0.5;
-          x1_check=(block.center[0]+2.5)/0.5;
-
-          if(board[x_check][z_check]==0 || board[x1_check][z1_check]==0)
-          {
-            no_of_moves++;
-            game_check=-1;
-            printf("Game Over\n");
-          }
-          else if(board[x_check][z_check]==4 || board[x1_check][z1_check]==4)
-          {
-            if(switch_check==0)
-              switch_check=1;
-            else if (switch_check==1)
-              switch_check=0;
-            no_of_moves++;
-            printf("Score:%d\n",no_of_moves);
-          }
-          else if(board[x_check][z_check]==2 || board[x1_check][z1_check]==2)
-          {
-            if(board[x_check][z_check]*board[x1_check][z1_check]==4)
-              no_of_moves++;
-            else if(board[x_check][z_check]*board[x1_check][z1_check]!=4)
-            {
-              no_of_moves++;
-              game_check=-1;
-              printf("Game Over\n");
-              printf("You Lost!!\n");
-              printf("End_Score:%d\n",no_of_moves);
-            }
-          }
-          else
-            no_of_moves++;
-        }
-      }
-      createblock(block.center[0],block.center[1],block.center[2],block.length,block.height,block.width,1,1,1);
-      // printf("new_rotate:%f\n",block.rotate);                      
+      printf("Score:%d\n",state.no_of_moves);
+      checkDeadEnd();
     }
-
+    createBlockFromState();
+    if(game_check==0)
+      checkpoint();
   }
 
-  if(game_check==1)
+  if(game_check==1 && level<=levelCount())
   {
     createBoard();
-    block.length=0.5;
-    block.height=1;
-    block.width=0.5;
-    block.center= glm:: vec3(0,0,0);
     block.rotate_check=0;
     block.rotate=0;
     game_check=0;
-    switch_check=0;
-    createblock(block.center[0],block.center[1],block.center[2],block.length,block.height,block.width,1,1,1);
+    start_level(&state,current_level);
+    showAllTiles();
+    current_hash=zobrist_hash(&keys,&current_board,&state);
+    undo_reset(&history,&state);
+    createBlockFromState();
+    checkpoint();
   }
 
 
-
-
-  int j=0;
-  for(i=0;i<10;i++)
+  // the tiles are in place in their chunk's mesh: one draw for the ones
+  // always there, one for each of the others that is there now
+  MVP = VP;
+  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+  int cx,cz;
+  for(cx=look_cx-CHUNK_DRAW_RADIUS;cx<=look_cx+CHUNK_DRAW_RADIUS;cx++)
   {
-    for(j=0;j<10;j++)
+    for(cz=look_cz-CHUNK_DRAW_RADIUS;cz<=look_cz+CHUNK_DRAW_RADIUS;cz++)
     {
-      if(board[i][j]==3 && switch_check==1)
-      {
-        glm::mat4 translateTile = glm::translate (board_pieces[i][j].center); // glTranslatef
-        glm::mat4 rotateTile = glm::rotate((float)(board_pieces[i][j].rotate*M_PI/180.0f), glm::vec3(0,0,1));  // rotate about vector (1,0,0)
-        glm::mat4 tileTransform = translateTile* rotateTile;
-        Matrices.model *= tileTransform; 
-        MVP = VP * Matrices.model; // MVP = p * V * M
-
-        //  Don't change unless you are sure!!
-        glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-        // draw3DObject draws the VAO given to it using current MVP matrix
-        draw3DObject(board_pieces[i][j].coordinates);
-        Matrices.model = glm::mat4(1.0f);
-      }
-      else if(board[i][j]!=0 && board[i][j]!=3)
-      {
-        glm::mat4 translateTile = glm::translate (board_pieces[i][j].center); // glTranslatef
-        glm::mat4 rotateTile = glm::rotate((float)(board_pieces[i][j].rotate*M_PI/180.0f), glm::vec3(0,0,1));  // rotate about vector (1,0,0)
-        glm::mat4 tileTransform = translateTile* rotateTile;
-        Matrices.model *= tileTransform; 
-        MVP = VP * Matrices.model; // MVP = p * V * M
-
-        //  Don't change unless you are sure!!
-        glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-        // draw3DObject draws the VAO given to it using current MVP matrix
-        draw3DObject(board_pieces[i][j].coordinates);
-
-        // Pop matrix to undo transformations till last push matrix instead of recomputing model matrix
-        // glPopMatrix ();
-        Matrices.model = glm::mat4(1.0f);
-      }
+      const chunk_slot *slot=ready_chunk(&chunks,cx,cz);
+      if(!slot || !slot->gpu)
+        continue;
+      const chunk_mesh *m=&slot->mesh;
+      VAO *vao=(VAO *)slot->gpu;
+      size_t k;
+      if(m->fixed)
+        draw3DObject(vao,0,CHUNK_TILE_VERTICES*m->fixed);
+      for(k=0;k<m->cells.size();k++)
+        if(shown[m->cells[k]])
+          draw3DObject(vao,CHUNK_TILE_VERTICES*(m->fixed+k),CHUNK_TILE_VERTICES);
     }
   }
   /*
@@ -1811,9 +1385,15 @@ void initGL (GLFWwindow* window, int width, int height)
   //	createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
   //	createRectangle ();
 
-  createblock(0,0,0,0.5,1,0.5,0,0,0);
-
   createBoard();
+  createBlockShapes();
+  if(!resumed)
+    start_level(&state,current_level);
+  state.tick%=current_board.period;   // a save from before the level changed
+  showAllTiles();
+  current_hash=zobrist_hash(&keys,&current_board,&state);
+  undo_reset(&history,&state);
+  createBlockFromState();
   // createCam();
   // Create and compile our GLSL program from the shaders
   programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
@@ -1843,7 +1423,62 @@ int main (int argc, char** argv)
   v_eye[0]=4;
   v_eye[1]=4;
   v_eye[2]=6;
-  printf("Score:%d\n",no_of_moves);
+
+  // --levels FILE plays a level pack instead of the built-in levels,
+  // --record FILE logs the hash of every move, --check FILE compares them
+  // against an earlier recording, --save FILE resumes from and checkpoints
+  // to a snapshot
+  for(int i=1;i+1<argc;i+=2)
+  {
+    if(!strcmp(argv[i],"--levels"))
+    {
+      // a binary pack is mapped, a text one parsed
+      int status=map_level_pack(argv[i+1],&packed);
+      if(status==LEVEL_PACK_BAD_MAGIC)
+      {
+        if(!read_level_pack(argv[i+1],&pack))
+          return 1;
+      }
+      else if(status!=LEVEL_PACK_OK)
+      {
+        printf("%s: %s\n",argv[i+1],level_pack_error(status));
+        return 1;
+      }
+      printf("%d levels from %s\n",levelCount(),argv[i+1]);
+    }
+    else if(!strcmp(argv[i],"--record"))
+    {
+      hash_record=fopen(argv[i+1],"w");
+      if(!hash_record)
+        printf("Cannot write %s\n",argv[i+1]);
+    }
+    else if(!strcmp(argv[i],"--check"))
+    {
+      hash_checking=read_hash_stream(argv[i+1],&hash_reference);
+      if(!hash_checking)
+        printf("Cannot read hash stream %s\n",argv[i+1]);
+    }
+    else if(!strcmp(argv[i],"--save"))
+      save_path=argv[i+1];
+  }
+  if(!packed.base && pack.empty())
+  {
+    builtin_pack(&pack);
+    builtin_levels=1;
+  }
+  if(save_path)
+  {
+    int status=load_game(save_path,packId(),levelCount(),&level,&state);
+    if(status==SAVE_OK)
+    {
+      resumed=1;
+      printf("Resuming level %d\n",level);
+    }
+    // no snapshot yet is a fresh start
+    else if(status!=SAVE_IO)
+      printf("Not resuming from %s: %s\n",save_path,save_error(status));
+  }
+  printf("Score:%d\n",state.no_of_moves);
 
   GLFWwindow* window = initGLFW(width, height);
 
@@ -1867,14 +1502,14 @@ int main (int argc, char** argv)
     if ((current_time - last_update_time) >=1) { // atleast 0.5s elapsed since last frame
       if(game_check==-1)
       {
-        printf("You Lost!!!\n");
+        printf("You Lost!!! Press Z to undo\n");
         system("play gameover.wav");
-        break;
+        game_check=-2;
       }
-      if(level==4)
+      if(level>levelCount())
       {
         printf("You Did It!!!\n");
-        printf("Total of %d Moves !!!\n",no_of_moves);
+        printf("Total of %d Moves !!!\n",state.no_of_moves);
         system("play world_clear.wav");
         break;
       }
@@ -1883,6 +1518,22 @@ int main (int argc, char** argv)
     }
   }
 
+  if(hash_checking && hash_mismatch<0)
+  {
+    if(hash_session.size()<hash_reference.size())
+      printf("Hash check: %d moves matched, the reference has %d\n",(int)hash_session.size(),(int)hash_reference.size());
+    else
+      printf("Hash check: all %d moves matched\n",(int)hash_session.size());
+  }
+  if(hash_record)
+    fclose(hash_record);
+  stop_distances(&distances);
+  mcts_stop(&bot);
+  // closing the window may have ended the GL context already, so the
+  // chunk meshes go with the process
+  std::vector<void *> freed;
+  stop_chunks(&chunks,&freed);
+
   glfwTerminate();
   //    exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,258 @@
+#include <chrono>
+#include <limits.h>
+
+#include "search.h"
+
+/*
+ * The estimate works on the block's centre with coordinates doubled so it
+ * is whole: (2x+1,2z+1) upright, one more along the axis it lies on. A
+ * roll moves the centre 2 or 3 of these along the axis it rolls in and not
+ * at all along the other, so each axis needs ceil(d/3) rolls of its own
+ * for a distance d, and two for a distance of 1. One roll changes the sum
+ * by at most one, so no state is ever reached more cheaply after it was
+ * expanded. A teleport is a target of its own, costing the estimate from
+ * where it sends the block.
+ */
+
+static inline int axis_rolls(int d)
+{
+  d=abs(d);
+  return (d==1) ? 2 : (d+2)/3;
+}
+
+static int estimate_at(const astar_search *s,int x2,int z2)
+{
+  int best=INT_MAX;
+  size_t i;
+
+  for(i=0;i<s->targets.size();i++)
+  {
+    const astar_target *t=&s->targets[i];
+    int h=axis_rolls(x2-t->x2)+axis_rolls(z2-t->z2)+t->cost;
+    if(h<best)
+      best=h;
+  }
+  return best;
+}
+
+int astar_estimate(const astar_search *s,const game_state *g)
+{
+  int o=block_orient(g->block);
+  int x2=2*block_x(g->block)+1+(o==ORIENT_LYING_X);
+  int z2=2*block_z(g->block)+1+(o==ORIENT_LYING_Z);
+
+  return estimate_at(s,x2,z2);
+}
+
+/* Goals cost nothing; each teleport costs the best estimate from its
+   target, relaxed until no teleport's cost drops */
+static void find_targets(astar_search *s)
+{
+  const level_board *b=s->board;
+  std::vector<uint32_t> sends;
+  int x,z;
+  size_t i;
+
+  s->targets.clear();
+  for(x=0;x<b->width;x++)
+  {
+    for(z=0;z<b->height;z++)
+    {
+      int c=cell_index(b,x,z);
+      astar_target t;
+      t.x2=2*x+1;
+      t.z2=2*z+1;
+      if(b->flags[c]&TF_GOAL)
+      {
+        t.cost=0;
+        s->targets.insert(s->targets.begin(),t);
+      }
+      else if(b->flags[c]&TF_TELEPORT)
+      {
+        t.cost=INT_MAX/2;
+        s->targets.push_back(t);
+        sends.push_back(b->target[c]);
+      }
+    }
+  }
+
+  size_t goals=s->targets.size()-sends.size();
+  int changed=1;
+  while(changed)
+  {
+    changed=0;
+    for(i=0;i<sends.size();i++)
+    {
+      int h=estimate_at(s,2*block_x(sends[i])+1,2*block_z(sends[i])+1);
+      if(h<s->targets[goals+i].cost)
+      {
+        s->targets[goals+i].cost=h;
+        changed=1;
+      }
+    }
+  }
+}
+
+/* Slot holding g, or the empty slot it belongs in */
+static int probe(const astar_search *s,const game_state *g)
+{
+  int mask=s->table.size()-1;
+  int i=state_hash(g)&mask;
+
+  while(s->table[i] && !same_state(&s->nodes[s->table[i]-1].s,g))
+    i=(i+1)&mask;
+  return i;
+}
+
+/* Queue node n by its rolls so far plus the estimate */
+static void push_open(astar_search *s,int n,int h)
+{
+  int f=s->nodes[n].s.no_of_moves+h;
+
+  if(f>=(int)s->open.size())
+    s->open.resize(f+1);
+  s->open[f].push_back(n);
+  if(f<s->f)
+    s->f=f;
+}
+
+void astar_start(astar_search *s,const level_board *b,const game_state *start,int capacity)
+{
+  int size=16;
+
+  s->board=b;
+  s->capacity=capacity;
+  s->expanded=0;
+  s->done=0;
+  s->full=0;
+  s->moves=-1;
+  s->path.clear();
+  s->open.clear();
+  s->f=0;
+  while(size<2*capacity)
+    size<<=1;
+  s->table.assign(size,0);
+  s->nodes.clear();
+  s->nodes.reserve(capacity);
+  find_targets(s);
+  if(s->targets.empty() || capacity<1)
+  {
+    s->done=1;
+    return;
+  }
+
+  astar_node root;
+  root.s=*start;
+  root.s.no_of_moves=0;
+  root.parent=-1;
+  root.dir=0;
+  s->nodes.push_back(root);
+  s->table[probe(s,&root.s)]=1;
+  push_open(s,0,astar_estimate(s,&root.s));
+}
+
+int astar_run(astar_search *s,long max_nodes)
+{
+  long budget=max_nodes;
+  int dir;
+
+  while(!s->done && budget>0)
+  {
+    while(s->f<(int)s->open.size() && s->open[s->f].empty())
+      s->f++;
+    // nothing left to expand: every reachable state was searched
+    if(s->f==(int)s->open.size())
+    {
+      s->done=1;
+      break;
+    }
+
+    // the newest node of a bucket is the deepest, which reaches the goal
+    // sooner among ties
+    int n=s->open[s->f].back();
+    s->open[s->f].pop_back();
+    game_state here=s->nodes[n].s;
+    // queued again since with fewer rolls
+    if(here.no_of_moves+astar_estimate(s,&here)!=s->f)
+      continue;
+    budget--;
+    s->expanded++;
+
+    for(dir=0;dir<NUM_DIRS;dir++)
+    {
+      game_state next=here;
+      int outcome=step(s->board,&next,dir);
+      if(outcome==MOVE_FALL)
+        continue;
+
+      // the estimate is at least one away from the goal, so a goal reached
+      // from here is within f, and every smaller f is searched
+      if(outcome==MOVE_GOAL)
+      {
+        s->moves=next.no_of_moves;
+        s->path.assign(s->moves,0);
+        s->path[s->moves-1]=dir;
+        int i=s->moves-2;
+        int k;
+        for(k=n;k>0;k=s->nodes[k].parent)
+          s->path[i--]=s->nodes[k].dir;
+        s->done=1;
+        break;
+      }
+
+      int slot=probe(s,&next);
+      int m=s->table[slot]-1;
+      if(m>=0)
+      {
+        if(s->nodes[m].s.no_of_moves<=next.no_of_moves)
+          continue;
+      }
+      else
+      {
+        if((int)s->nodes.size()==s->capacity)
+        {
+          s->full=1;
+          s->done=1;
+          break;
+        }
+        m=s->nodes.size();
+        s->nodes.push_back(astar_node());
+        s->table[slot]=m+1;
+      }
+      s->nodes[m].s=next;
+      s->nodes[m].parent=n;
+      s->nodes[m].dir=dir;
+      push_open(s,m,astar_estimate(s,&next));
+    }
+  }
+  return s->done;
+}
+
+void solve_astar(const level_board *b,const game_state *start,solve_result *r)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  astar_search s;
+  uint32_t used=0;
+  int i;
+
+  // room for every state: three orientations on each cell, times each
+  // switch group and crumble tile there is and each tick of the period,
+  // up to a pool of 4M
+  for(i=0;i<(int)b->tiles.size();i++)
+    if(b->flags[i]&(TF_SWITCH|TF_BRIDGE))
+      used|=1u<<b->group[i];
+  long capacity=3L*b->width*b->height*b->period;
+  int bits=__builtin_popcount(used)+b->crumble_count;
+  for(i=0;i<bits && capacity<(1<<22);i++)
+    capacity*=2;
+  if(capacity>(1<<22))
+    capacity=1<<22;
+
+  astar_start(&s,b,start,capacity);
+  astar_run(&s,LONG_MAX);
+  r->moves=s.moves;
+  r->gave_up=s.full;
+  r->path=s.path;
+  r->states=s.nodes.size();
+  r->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
@@ -0,0 +1,208 @@
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "batch.h"
+
+void prepare_batch_board(batch_board *bb,const level_board *b)
+{
+  int i;
+
+  bb->board=b;
+  bb->cell.resize(b->flags.size());
+  for(i=0;i<(int)b->flags.size();i++)
+    bb->cell[i]=b->flags[i] | b->group[i]<<16;
+}
+
+void init_batch(game_batch *g,int count,int x,int z)
+{
+  g->count=count;
+  g->block.assign(count,pack_block(x,z,ORIENT_STANDING));
+  g->switch_check.assign(count,0);
+  g->damage.assign(count,0);
+  g->tick.assign(count,0);
+  g->no_of_moves.assign(count,0);
+  g->done.assign(count,0);
+}
+
+void restart_finished(game_batch *g,int begin,int end,int x,int z)
+{
+  int i;
+
+  for(i=begin;i<end;i++)
+  {
+    if(g->done[i])
+    {
+      g->block[i]=pack_block(x,z,ORIENT_STANDING);
+      g->switch_check[i]=0;
+      g->damage[i]=0;
+      g->tick[i]=0;
+      g->no_of_moves[i]=0;
+      g->done[i]=0;
+    }
+  }
+}
+
+void step_batch_scalar(const batch_board *bb,game_batch *g,int begin,int end,const unsigned char *moves,unsigned char *outcomes)
+{
+  int i;
+
+  for(i=begin;i<end;i++)
+  {
+    if(g->done[i])
+    {
+      outcomes[i]=MOVE_IDLE;
+      continue;
+    }
+
+    game_state s;
+    s.block=g->block[i];
+    s.switch_check=g->switch_check[i];
+    s.damage=g->damage[i];
+    s.tick=g->tick[i];
+    s.no_of_moves=g->no_of_moves[i];
+
+    int outcome=step(bb->board,&s,moves[i]);
+
+    g->block[i]=s.block;
+    g->switch_check[i]=s.switch_check;
+    g->damage[i]=s.damage;
+    g->tick[i]=s.tick;
+    g->no_of_moves[i]=s.no_of_moves;
+    g->done[i]=(outcome==MOVE_FALL || outcome==MOVE_GOAL);
+    outcomes[i]=outcome;
+  }
+}
+
+#ifdef __AVX2__
+
+/* Bit n of every lane as 0 or 1 */
+static inline __m256i lane_bit(__m256i v,int n)
+{
+  return _mm256_and_si256(_mm256_srli_epi32(v,n),_mm256_set1_epi32(1));
+}
+
+static inline int lane_bit_of(int flag)
+{
+  return __builtin_ctz(flag);
+}
+
+void step_batch(const batch_board *bb,game_batch *g,int begin,int end,const unsigned char *moves,unsigned char *outcomes)
+{
+  const level_board *b=bb->board;
+  const __m256i one=_mm256_set1_epi32(1);
+  const __m256i zero=_mm256_setzero_si256();
+  const __m256i coord_mask=_mm256_set1_epi32(BLOCK_COORD_MASK);
+  const __m256i pad=_mm256_set1_epi32(BOARD_PAD);
+  const __m256i stride=_mm256_set1_epi32(b->stride);
+  const __m256i special_flags=_mm256_set1_epi32(TF_SPECIAL);
+  const __m256i flag_mask=_mm256_set1_epi32(0xffff);
+  const __m256i period=_mm256_set1_epi32(b->period);
+  const __m256i group_mask=_mm256_set1_epi32(MAX_GROUPS-1);
+  int i=begin;
+
+  for(;i+8<=end;i+=8)
+  {
+    __m256i blk=_mm256_loadu_si256((const __m256i *)&g->block[i]);
+    __m256i sw=_mm256_loadu_si256((const __m256i *)&g->switch_check[i]);
+    __m256i done=_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&g->done[i]));
+    __m256i dir=_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&moves[i]));
+    __m256i active=_mm256_cmpeq_epi32(done,zero);
+
+    // roll: decode the packed word, look the move up in the roll tables
+    __m256i o=_mm256_srli_epi32(blk,30);
+    __m256i x=_mm256_srai_epi32(_mm256_slli_epi32(blk,17),17);
+    __m256i z=_mm256_srai_epi32(_mm256_slli_epi32(blk,2),17);
+    __m256i roll=_mm256_add_epi32(_mm256_slli_epi32(o,2),dir);
+    x=_mm256_add_epi32(x,_mm256_i32gather_epi32(&roll_dx[0][0],roll,4));
+    z=_mm256_add_epi32(z,_mm256_i32gather_epi32(&roll_dz[0][0],roll,4));
+    o=_mm256_i32gather_epi32(&roll_orient[0][0],roll,4);
+    __m256i moved=_mm256_or_si256(_mm256_or_si256(_mm256_and_si256(x,coord_mask),
+          _mm256_slli_epi32(_mm256_and_si256(z,coord_mask),BLOCK_COORD_BITS)),_mm256_slli_epi32(o,30));
+
+    // footprint: finished games may sit off the padded board, read cell 0 for them
+    __m256i c0=_mm256_add_epi32(_mm256_mullo_epi32(_mm256_add_epi32(x,pad),stride),_mm256_add_epi32(z,pad));
+    c0=_mm256_and_si256(c0,active);
+    __m256i c1=_mm256_add_epi32(c0,_mm256_and_si256(_mm256_i32gather_epi32(b->second_cell,o,4),active));
+    __m256i w0=_mm256_i32gather_epi32(&bb->cell[0],c0,4);
+    __m256i w1=_mm256_i32gather_epi32(&bb->cell[0],c1,4);
+    __m256i f0=_mm256_and_si256(w0,flag_mask);
+    __m256i f1=_mm256_and_si256(w1,flag_mask);
+    __m256i g0=_mm256_and_si256(_mm256_srli_epi32(w0,16),group_mask);
+    __m256i g1=_mm256_and_si256(_mm256_srli_epi32(w1,16),group_mask);
+
+    // teleports, crumble and timed tiles are rare: hand these eight to step()
+    __m256i special=_mm256_and_si256(_mm256_or_si256(f0,f1),special_flags);
+    special=_mm256_andnot_si256(_mm256_cmpeq_epi32(special,zero),active);
+    if(!_mm256_testz_si256(special,special))
+    {
+      step_batch_scalar(bb,g,i,i+8,moves,outcomes);
+      continue;
+    }
+
+    // the same flag arithmetic as land(), one 0/1 per lane
+    __m256i standing=_mm256_and_si256(_mm256_cmpeq_epi32(o,zero),one);
+    __m256i held0=_mm256_or_si256(lane_bit(f0,lane_bit_of(TF_SOLID)),
+          _mm256_and_si256(lane_bit(f0,lane_bit_of(TF_BRIDGE)),_mm256_and_si256(_mm256_srlv_epi32(sw,g0),one)));
+    __m256i held1=_mm256_or_si256(lane_bit(f1,lane_bit_of(TF_SOLID)),
+          _mm256_and_si256(lane_bit(f1,lane_bit_of(TF_BRIDGE)),_mm256_and_si256(_mm256_srlv_epi32(sw,g1),one)));
+    __m256i fragile0=lane_bit(f0,lane_bit_of(TF_FRAGILE));
+    __m256i fragile1=lane_bit(f1,lane_bit_of(TF_FRAGILE));
+    __m256i press0=_mm256_and_si256(lane_bit(f0,lane_bit_of(TF_SWITCH)),
+          _mm256_or_si256(standing,_mm256_xor_si256(lane_bit(f0,lane_bit_of(TF_HEAVY)),one)));
+    __m256i press1=_mm256_and_si256(lane_bit(f1,lane_bit_of(TF_SWITCH)),
+          _mm256_or_si256(standing,_mm256_xor_si256(lane_bit(f1,lane_bit_of(TF_HEAVY)),one)));
+    __m256i pressed=_mm256_or_si256(press0,press1);
+
+    __m256i fall=_mm256_or_si256(_mm256_xor_si256(_mm256_and_si256(held0,held1),one),
+          _mm256_or_si256(_mm256_and_si256(standing,fragile0),
+            _mm256_andnot_si256(pressed,_mm256_xor_si256(fragile0,fragile1))));
+    __m256i stays=_mm256_xor_si256(fall,one);
+    __m256i goal=_mm256_and_si256(stays,_mm256_and_si256(standing,lane_bit(f0,lane_bit_of(TF_GOAL))));
+    __m256i toggle=_mm256_or_si256(_mm256_sllv_epi32(press0,g0),_mm256_sllv_epi32(press1,g1));
+    toggle=_mm256_and_si256(toggle,_mm256_cmpeq_epi32(fall,zero));
+
+    // MOVE_FALL=2, MOVE_GOAL=3, MOVE_SWITCH=1, MOVE_OK=0; finished games idle
+    __m256i outcome=_mm256_or_si256(_mm256_slli_epi32(fall,1),
+          _mm256_or_si256(_mm256_mullo_epi32(goal,_mm256_set1_epi32(MOVE_GOAL)),_mm256_and_si256(stays,pressed)));
+    outcome=_mm256_blendv_epi8(_mm256_set1_epi32(MOVE_IDLE),outcome,active);
+
+    blk=_mm256_blendv_epi8(blk,moved,active);
+    sw=_mm256_xor_si256(sw,_mm256_and_si256(toggle,active));
+    done=_mm256_or_si256(done,_mm256_and_si256(_mm256_or_si256(fall,goal),active));
+    __m256i count=_mm256_loadu_si256((const __m256i *)&g->no_of_moves[i]);
+    count=_mm256_sub_epi32(count,active);
+    __m256i tick=_mm256_loadu_si256((const __m256i *)&g->tick[i]);
+    tick=_mm256_sub_epi32(tick,active);
+    tick=_mm256_andnot_si256(_mm256_cmpeq_epi32(tick,period),tick);
+
+    _mm256_storeu_si256((__m256i *)&g->block[i],blk);
+    _mm256_storeu_si256((__m256i *)&g->switch_check[i],sw);
+    _mm256_storeu_si256((__m256i *)&g->no_of_moves[i],count);
+    _mm256_storeu_si256((__m256i *)&g->tick[i],tick);
+
+    // narrow the two 0-4 results back to bytes
+    __m256i packed=_mm256_packus_epi32(_mm256_or_si256(outcome,_mm256_slli_epi32(done,8)),zero);
+    packed=_mm256_permute4x64_epi64(packed,0x08);
+    __m128i lanes=_mm256_castsi256_si128(packed);
+    uint8_t tmp[16];
+    _mm_storeu_si128((__m128i *)tmp,lanes);
+    int k;
+    for(k=0;k<8;k++)
+    {
+      outcomes[i+k]=tmp[2*k];
+      g->done[i+k]=tmp[2*k+1];
+    }
+  }
+
+  step_batch_scalar(bb,g,i,end,moves,outcomes);
+}
+
+#else
+
+void step_batch(const batch_board *bb,game_batch *g,int begin,int end,const unsigned char *moves,unsigned char *outcomes)
+{
+  step_batch_scalar(bb,g,begin,end,moves,outcomes);
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "rules.h"
+
+/*
+ * Many independent games on one board, kept as structure-of-arrays so a
+ * step over the batch streams through each field. step_batch() resolves
+ * eight games at a time with AVX2 when built with it (-mavx2 or
+ * -march=native) and falls back to step_batch_scalar(), the plain step()
+ * loop, otherwise and for the rare games that touch a teleport, crumble or
+ * timed tile.
+ */
+
+#define MOVE_IDLE 4   // outcome reported for a game that had already ended
+
+typedef struct game_batch
+{
+  int count;
+  std::vector<uint32_t> block;
+  std::vector<uint32_t> switch_check;
+  std::vector<uint32_t> damage;
+  std::vector<uint32_t> tick;
+  std::vector<int> no_of_moves;
+  std::vector<unsigned char> done;   // set once the game fell or reached the goal
+}game_batch;
+
+/* The board widened to one 32-bit word per cell (flags | group<<16) so the
+   vector path can gather both cells under eight blocks at once */
+typedef struct batch_board
+{
+  const level_board *board;
+  std::vector<int32_t> cell;
+}batch_board;
+
+void prepare_batch_board(batch_board *bb,const level_board *b);
+
+/* count games, each with the block upright on (x,z) */
+void init_batch(game_batch *g,int count,int x,int z);
+
+/* Start games begin..end-1 that have ended over again from (x,z) */
+void restart_finished(game_batch *g,int begin,int end,int x,int z);
+
+/* Roll game i in direction moves[i] for every i in begin..end-1 and store
+   the MOVE_* result in outcomes[i] */
+void step_batch_scalar(const batch_board *bb,game_batch *g,int begin,int end,const unsigned char *moves,unsigned char *outcomes);
+void step_batch(const batch_board *bb,game_batch *g,int begin,int end,const unsigned char *moves,unsigned char *outcomes);
+
+#endif
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+
+#include "search.h"
+
+/*
+ * Breadth-first search over whole layers of states at once. States are
+ * grouped by switch_check, and each group keeps one bitboard per
+ * orientation over the padded cells, so a roll of every block in a layer
+ * is a shift of that bitboard by the roll's cell offset. Landings are then
+ * resolved with the same flag arithmetic as land() over whole words:
+ *
+ *   held     both cells are solid or an extended bridge
+ *   breaks   an upright block on fragile, or a lying block half on
+ *            fragile with no switch pressed
+ *   pressed  a switch under any part of the block (heavy ones only upright)
+ *
+ * Only the few cells that press a switch leave their group, and those are
+ * moved one at a time. Each layer remembers the span of words its frontier
+ * occupies, so a pass only touches the part of the board that is moving.
+ *
+ * On a board with timed tiles every state of one layer of the search is on
+ * the same tick, the depth plus the start's tick modulo the period, so the
+ * tick is never stored with a state. Each switch group keeps its landing
+ * masks and its seen states once per tick of the period instead, and the
+ * memory grows with the period rather than with the depth of the search.
+ */
+
+typedef struct switch_layer
+{
+  uint32_t switch_check;
+  std::vector<bitboard> held[3];   // by tick, cells a block of each orientation can rest on
+  std::vector<bitboard> seen[3];   // by tick
+  bitboard frontier[3];
+  bitboard next[3];
+  int lo,hi;              // words holding frontier states, empty when lo>hi
+  int next_lo,next_hi;    // words next may have been written in
+}switch_layer;
+
+/* Masks shared by every switch layer, and the layers themselves */
+typedef struct bit_search
+{
+  const level_board *board;
+  int words;
+  bitboard bridge[MAX_GROUPS];   // bridge cells of each switch group
+  bitboard pressed[3];           // cells where a block of each orientation presses a switch
+  bitboard breaks[3];            // cells where it falls through fragile tiles
+  bitboard goal;
+  std::vector<bitboard> away;    // by tick, timed tiles that aren't there
+  std::deque<switch_layer> layers;   // a deque, so a layer stays put while others are added
+  std::unordered_map<uint32_t,int> layer_of;
+}bit_search;
+
+/* OR src moved k cells up (k>0) or down (k<0) the padded cell order into
+   words lo..hi of dst */
+static void shift_or(const bitboard &src,int k,bitboard &dst,int lo,int hi)
+{
+  int n=src.size();
+  int w=k>>6;    // floor(k/64)
+  int s=k&63;
+  int i;
+
+  // words i draws from src[i-w] and src[i-w-1]; the edges where either is
+  // off the board are done apart so the middle loop has no tests
+  int first=std::max(lo,w+1);
+  int last=std::min(hi,n-1+w);
+  for(i=lo;i<=hi && i<first;i++)
+  {
+    int j=i-w;
+    uint64_t upper=(j>=0 && j<n) ? src[j] : 0;
+    uint64_t lower=(j-1>=0 && j-1<n) ? src[j-1] : 0;
+    dst[i]|=s ? (upper<<s | lower>>(64-s)) : upper;
+  }
+  if(s)
+    for(;i<=last;i++)
+      dst[i]|=src[i-w]<<s | src[i-w-1]>>(64-s);
+  else
+    for(;i<=last;i++)
+      dst[i]|=src[i-w];
+  for(;i<=hi;i++)
+  {
+    int j=i-w;
+    uint64_t upper=(j>=0 && j<n) ? src[j] : 0;
+    uint64_t lower=(j-1>=0 && j-1<n) ? src[j-1] : 0;
+    dst[i]|=s ? (upper<<s | lower>>(64-s)) : upper;
+  }
+}
+
+static void shift_or(const bitboard &src,int k,bitboard &dst)
+{
+  shift_or(src,k,dst,0,src.size()-1);
+}
+
+static int any_bits(const bitboard &m)
+{
+  size_t i;
+
+  for(i=0;i<m.size();i++)
+    if(m[i])
+      return 1;
+  return 0;
+}
+
+static long count_bits(const bitboard &m)
+{
+  long n=0;
+  size_t i;
+
+  for(i=0;i<m.size();i++)
+    n+=__builtin_popcountll(m[i]);
+  return n;
+}
+
+static void set_cell(bitboard &m,int c)
+{
+  m[c>>6]|=1ull<<(c&63);
+}
+
+/* The layer for switch_check sw, set up on first use */
+static switch_layer &layer(bit_search *bs,uint32_t sw)
+{
+  std::unordered_map<uint32_t,int>::iterator it=bs->layer_of.find(sw);
+  int o,g,i;
+
+  if(it!=bs->layer_of.end())
+    return bs->layers[it->second];
+  bs->layer_of[sw]=bs->layers.size();
+  bs->layers.push_back(switch_layer());
+
+  switch_layer &l=bs->layers.back();
+  int period=bs->board->period;
+  int t;
+  bitboard bridges(bs->words,0),support;
+  for(g=0;g<MAX_GROUPS;g++)
+    if((sw>>g)&1)
+      for(i=0;i<bs->words;i++)
+        bridges[i]|=bs->bridge[g][i];
+  l.switch_check=sw;
+  l.lo=l.next_lo=bs->words;
+  l.hi=l.next_hi=-1;
+  for(o=0;o<3;o++)
+  {
+    l.held[o].resize(period);
+    l.seen[o].assign(period,bitboard(bs->words,0));
+    l.frontier[o].assign(bs->words,0);
+    l.next[o].assign(bs->words,0);
+  }
+  for(t=0;t<period;t++)
+  {
+    support=bs->board->solid;
+    for(i=0;i<bs->words;i++)
+      support[i]=(support[i]&~bs->away[t][i])|bridges[i];
+    for(o=0;o<3;o++)
+    {
+      l.held[o][t].assign(bs->words,0);
+      shift_or(support,-bs->board->second_cell[o],l.held[o][t]);
+      for(i=0;i<bs->words;i++)
+        l.held[o][t][i]&=support[i]&~bs->breaks[o][i];
+    }
+  }
+  return l;
+}
+
+static void widen(int *lo,int *hi,int from,int to)
+{
+  if(from<*lo)
+    *lo=from;
+  if(to>*hi)
+    *hi=to;
+}
+
+/* Land the rolls in words lo..hi of arrive[] on layer n on tick t: plain
+   landings join its next frontier, switch presses the next frontier of the
+   layer they switch to. Returns 1 if a block stood on the goal. */
+static int land_layer(bit_search *bs,int n,bitboard arrive[3],int lo,int hi,int t)
+{
+  const level_board *b=bs->board;
+  int found=0;
+  int o,i;
+
+  widen(&bs->layers[n].next_lo,&bs->layers[n].next_hi,lo,hi);
+  for(o=0;o<3;o++)
+  {
+    switch_layer &l=bs->layers[n];
+    int k=b->second_cell[o];
+
+    for(i=lo;i<=hi;i++)
+    {
+      uint64_t land=arrive[o][i]&l.held[o][t][i];
+      if(o==ORIENT_STANDING && (land&bs->goal[i]))
+        found=1;
+      l.next[o][i]|=land&~bs->pressed[o][i]&~l.seen[o][t][i];
+      arrive[o][i]=land&bs->pressed[o][i];
+    }
+
+    for(i=lo;i<=hi;i++)
+    {
+      uint64_t w=arrive[o][i];
+      while(w)
+      {
+        int c=i*64+__builtin_ctzll(w);
+        unsigned f0=b->flags[c],f1=b->flags[c+k];
+        int press0=((f0&TF_SWITCH)!=0) & ((o==ORIENT_STANDING) | ((f0&TF_HEAVY)==0));
+        int press1=((f1&TF_SWITCH)!=0) & ((o==ORIENT_STANDING) | ((f1&TF_HEAVY)==0));
+        uint32_t sw=bs->layers[n].switch_check^(((uint32_t)press0<<b->group[c]) | ((uint32_t)press1<<b->group[c+k]));
+        switch_layer &to=layer(bs,sw);
+        if(!((to.seen[o][t][i]>>(c&63))&1))
+        {
+          set_cell(to.next[o],c);
+          widen(&to.next_lo,&to.next_hi,i,i);
+        }
+        w&=w-1;
+      }
+    }
+  }
+  return found;
+}
+
+void solve_bitbfs(const level_board *b,const game_state *start,solve_result *r)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  int words=b->solid.size();
+  int o,d,i,g,n;
+
+  r->path.clear();
+  r->moves=-1;
+  r->gave_up=0;
+  r->states=0;
+
+  // teleports and crumble tiles aren't local to a cell's neighbours
+  if(any_bits(b->mask[TILE_TELEPORT]) || any_bits(b->mask[TILE_CRUMBLE]))
+  {
+    solve_bfs(b,start,r);
+    return;
+  }
+
+  // bridges of each switch group, and the per-orientation landing masks
+  // that don't depend on the switches
+  bit_search bs;
+  bitboard fragile(words,0),light(words,0),any_switch(words,0);
+  bs.board=b;
+  bs.words=words;
+  for(g=0;g<MAX_GROUPS;g++)
+    bs.bridge[g].assign(words,0);
+  bs.goal.assign(words,0);
+  bs.away.assign(b->period,bitboard(words,0));
+  for(i=0;i<(int)b->tiles.size();i++)
+  {
+    unsigned f=b->flags[i];
+    if(f&TF_TIMED)
+      for(g=0;g<b->period;g++)
+        if(!((b->present[i]>>g)&1))
+          set_cell(bs.away[g],i);
+    if(f&TF_BRIDGE)
+      set_cell(bs.bridge[b->group[i]],i);
+    if(f&TF_FRAGILE)
+      set_cell(fragile,i);
+    if(f&TF_SWITCH)
+      set_cell(any_switch,i);
+    if((f&TF_SWITCH) && !(f&TF_HEAVY))
+      set_cell(light,i);
+    if(f&TF_GOAL)
+      set_cell(bs.goal,i);
+  }
+  for(o=0;o<3;o++)
+  {
+    int k=b->second_cell[o];
+    bitboard &pressed=bs.pressed[o];
+    bitboard &breaks=bs.breaks[o];
+
+    if(o==ORIENT_STANDING)
+    {
+      pressed=any_switch;
+      breaks=fragile;
+      continue;
+    }
+    pressed=light;
+    shift_or(light,-k,pressed);
+    breaks.assign(words,0);
+    shift_or(fragile,-k,breaks);
+    for(i=0;i<words;i++)
+      breaks[i]=(fragile[i]^breaks[i])&~pressed[i];
+  }
+
+  int offset[3][NUM_DIRS];
+  for(o=0;o<3;o++)
+    for(d=0;d<NUM_DIRS;d++)
+      offset[o][d]=roll_dx[o][d]*b->stride+roll_dz[o][d];
+
+  // a roll moves a cell at most two rows, so it reaches this many words
+  // past the frontier
+  int reach=(2*b->stride+2)/64+1;
+
+  int c0=cell_index(b,block_x(start->block),block_z(start->block));
+  switch_layer &first=layer(&bs,start->switch_check);
+  set_cell(first.frontier[block_orient(start->block)],c0);
+  set_cell(first.seen[block_orient(start->block)][start->tick],c0);
+  first.lo=first.hi=c0>>6;
+
+  bitboard arrive[3];
+  for(o=0;o<3;o++)
+    arrive[o].assign(words,0);
+
+  int depth=0,found=0,busy=1;
+  while(busy && !found)
+  {
+    depth++;
+    int t=(start->tick+depth)%b->period;
+    // layers added while landing only hold next states, so the count taken
+    // here covers every frontier
+    int count=bs.layers.size();
+    for(n=0;n<count && !found;n++)
+    {
+      if(bs.layers[n].lo>bs.layers[n].hi)
+        continue;
+      int lo=std::max(bs.layers[n].lo-reach,0);
+      int hi=std::min(bs.layers[n].hi+reach,words-1);
+
+      // every roll of every orientation, gathered by the orientation it
+      // lands in
+      for(o=0;o<3;o++)
+        std::fill(arrive[o].begin()+lo,arrive[o].begin()+hi+1,0);
+      for(o=0;o<3;o++)
+      {
+        const bitboard &frontier=bs.layers[n].frontier[o];
+        for(d=0;d<NUM_DIRS;d++)
+        {
+          shift_or(frontier,offset[o][d],arrive[roll_orient[o][d]],lo,hi);
+        }
+      }
+      found=land_layer(&bs,n,arrive,lo,hi,t);
+    }
+
+    // the next states become the frontier
+    busy=0;
+    for(n=0;n<(int)bs.layers.size();n++)
+    {
+      switch_layer &l=bs.layers[n];
+      int lo=words,hi=-1;
+      for(o=0;o<3;o++)
+      {
+        if(l.lo<=l.hi)
+          std::fill(l.frontier[o].begin()+l.lo,l.frontier[o].begin()+l.hi+1,0);
+        for(i=l.next_lo;i<=l.next_hi;i++)
+        {
+          uint64_t w=l.next[o][i]&~l.seen[o][t][i];
+          l.seen[o][t][i]|=w;
+          l.frontier[o][i]=w;
+          l.next[o][i]=0;
+          if(w)
+            widen(&lo,&hi,i,i);
+        }
+      }
+      l.lo=lo;
+      l.hi=hi;
+      l.next_lo=words;
+      l.next_hi=-1;
+      busy|=(lo<=hi);
+    }
+  }
+
+  for(n=0;n<(int)bs.layers.size();n++)
+    for(o=0;o<3;o++)
+      for(i=0;i<b->period;i++)
+        r->states+=count_bits(bs.layers[n].seen[o][i]);
+  r->moves=found ? depth : -1;
+  r->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
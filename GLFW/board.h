@@ -0,0 +1,73 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include "rules.h"
+
+/*
+ * Level tiles, one byte each, indexed tile[x][z] like the game board.
+ * Board<W,H> has its size fixed at compile time, so the built-in levels
+ * are plain arrays, and the loops that load them into a level_board and
+ * solve them while compiling (levelcheck.h) have constant bounds and cell
+ * offsets. Board<Dynamic> holds a level whose size is only known once it
+ * is loaded. Play itself runs on the level_board whatever the level's
+ * size, since step() and the searches take its stride at run time.
+ */
+enum { Dynamic=-1 };
+
+template<int W,int H=W>
+struct Board
+{
+  static constexpr int width=W;
+  static constexpr int height=H;
+
+  // the same padded layout level_board uses
+  static constexpr int stride=H+2*BOARD_PAD;
+  static constexpr int cells=(W+2*BOARD_PAD)*stride;
+  static constexpr int neighbour[NUM_DIRS]={ -stride, stride, 1, -1 };  // by DIR_*
+
+  static constexpr int cell(int x,int z) { return (x+BOARD_PAD)*stride+z+BOARD_PAD; }
+
+  unsigned char tile[W][H];
+
+  int at(int x,int z) const { return tile[x][z]; }
+  void set(int x,int z,int t) { tile[x][z]=t; }
+};
+
+template<>
+struct Board<Dynamic,Dynamic>
+{
+  int width,height;
+  std::vector<unsigned char> tile;   // tile[x*height+z]
+
+  Board(int w=0,int h=0) : width(w),height(h),tile(w*h,TILE_VOID) {}
+
+  int at(int x,int z) const { return tile[x*height+z]; }
+  void set(int x,int z,int t) { tile[x*height+z]=t; }
+};
+
+/* Copy a level into b, every switch and bridge in group 0 */
+template<int W,int H>
+void load_board(level_board *b,const Board<W,H> &level)
+{
+  typedef Board<W,H> B;
+  int x,z;
+
+  clear_board(b,W,H);
+  for(x=0;x<W;x++)
+    for(z=0;z<H;z++)
+      b->tiles[B::cell(x,z)]=level.tile[x][z];
+  index_board(b);
+}
+
+static inline void load_board(level_board *b,const Board<Dynamic> &level)
+{
+  int x,z;
+
+  clear_board(b,level.width,level.height);
+  for(x=0;x<level.width;x++)
+    for(z=0;z<level.height;z++)
+      b->tiles[cell_index(b,x,z)]=level.at(x,z);
+  index_board(b);
+}
+
+#endif
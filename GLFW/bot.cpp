@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <thread>
+
+#include "rules.h"
+#include "levels.h"
+#include "mcts.h"
+
+/*
+ * Headless Monte Carlo player: plays each level one roll at a time with
+ * mcts_choose() and reports how many rolls it took, against the par where
+ * the level gives one, and how many rollouts a second it ran. Levels are
+ * named as for the solver; with none it plays every built-in level. Exits
+ * non-zero if it fails to clear any. --threads sets the trees grown at
+ * once (the hardware's threads by default), --rollouts the budget for each
+ * roll, --nodes the arena of each tree, --depth the random rolls of a
+ * rollout and --moves the rolls it gets before giving up.
+ *
+ *   ./bot [--threads N] [--rollouts N] [--nodes N] [--depth N] [--moves N] [LEVEL|PACK]...
+ */
+
+static int threads=std::thread::hardware_concurrency();
+static long rollouts=4000;
+static int nodes=1<<16;
+static int depth=64;
+static int most_moves=1000;
+
+/* Play level l; returns 0 if the bot doesn't clear it */
+static int play_one(const char *arg,const level_def *l)
+{
+  level_board board;
+  game_state state;
+  mcts_bot bot;
+  int par=l->par;
+  long total=0;
+  double seconds=0;
+  int outcome=MOVE_OK;
+  std::vector<unsigned char> path;
+
+  load_level(&board,l);
+  start_level(&state,l);
+  state.no_of_moves=0;
+  mcts_init(&bot,&board,threads,nodes,depth);
+  while(outcome!=MOVE_GOAL && outcome!=MOVE_FALL && state.no_of_moves<most_moves)
+  {
+    int dir=mcts_choose(&bot,&state,rollouts);
+    if(dir<0)
+      break;
+    total+=bot.rollouts;
+    seconds+=bot.seconds;
+    outcome=step(&board,&state,dir);
+    path.push_back(dir);
+  }
+
+  double rate=(seconds>0) ? total/seconds : 0;
+  if(outcome!=MOVE_GOAL)
+    printf("%s: not cleared after %d moves, %ld rollouts in %.3f s (%.2fM rollouts/s)\n",
+        arg,state.no_of_moves,total,seconds,rate/1e6);
+  else if(par>0)
+    printf("%s: %d moves %s, par %d (%.2fx), %ld rollouts in %.3f s (%.2fM rollouts/s)\n",
+        arg,state.no_of_moves,path_string(path).c_str(),par,(double)state.no_of_moves/par,total,seconds,rate/1e6);
+  else
+    printf("%s: %d moves %s, %ld rollouts in %.3f s (%.2fM rollouts/s)\n",
+        arg,state.no_of_moves,path_string(path).c_str(),total,seconds,rate/1e6);
+  return outcome==MOVE_GOAL;
+}
+
+/* Play the levels named by arg; returns 0 if they can't be loaded or any
+   isn't cleared */
+static int play_level(const char *arg)
+{
+  std::vector<level_def> pack;
+  char name[4096];
+  size_t i;
+  int ok=1;
+
+  if(!read_levels(arg,&pack))
+    return 0;
+  for(i=0;i<pack.size();i++)
+  {
+    if(pack.size()>1)
+      snprintf(name,sizeof(name),"%s:%d",arg,(int)i+1);
+    else
+      snprintf(name,sizeof(name),"%s",arg);
+    ok&=play_one(name,&pack[i]);
+  }
+  return ok;
+}
+
+int main(int argc,char **argv)
+{
+  int ok=1;
+  int i,first=1;
+
+  for(;first<argc && !strncmp(argv[first],"--",2);first++)
+  {
+    if(first+1<argc && !strcmp(argv[first],"--threads"))
+      threads=atoi(argv[++first]);
+    else if(first+1<argc && !strcmp(argv[first],"--rollouts"))
+      rollouts=atol(argv[++first]);
+    else if(first+1<argc && !strcmp(argv[first],"--nodes"))
+      nodes=atoi(argv[++first]);
+    else if(first+1<argc && !strcmp(argv[first],"--depth"))
+      depth=atoi(argv[++first]);
+    else if(first+1<argc && !strcmp(argv[first],"--moves"))
+      most_moves=atoi(argv[++first]);
+    else
+    {
+      printf("Unknown option %s\n",argv[first]);
+      return 2;
+    }
+  }
+  if(argc<=first)
+  {
+    for(i=1;i<=NUM_LEVELS;i++)
+    {
+      char name[16];
+      snprintf(name,sizeof(name),"%d",i);
+      ok&=play_level(name);
+    }
+  }
+  for(i=first;i<argc;i++)
+    ok&=play_level(argv[i]);
+  return !ok;
+}
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+
+#include "chunks.h"
+
+const float tile_palette[NUM_TILES][3][3]={
+  { {0,0,0},       {0,0,0},       {0,0,0} },  // void, never drawn
+  { {0.6,0,0},     {1,0,0},       {0,0,0} },  // normal
+  { {0.5,0.5,0.5}, {0.9,0.9,0.9}, {0,0,0} },  // fragile
+  { {0,0,0.6},     {0.2,0.2,1},   {0,0,0} },  // bridge
+  { {0,0.6,0},     {0.2,1,0.2},   {0,0,0} },  // switch
+  { {0,0.35,0},    {0.1,0.6,0.1}, {1,1,1} },  // heavy switch
+  { {0.6,0,0},     {0,0,0},       {0,0,0} },  // goal
+  { {0.4,0,0.4},   {0.8,0.2,0.8}, {0,0,0} },  // teleport
+  { {0.6,0.3,0},   {1,0.6,0.2},   {0,0,0} },  // crumble
+  { {0,0.45,0.5},  {0.3,0.9,1},   {0,0,0} }   // timed
+};
+
+#define TILE_SIDE 0.5f   // a tile is TILE_SIDE across and a quarter high
+
+/* Corners of a tile centred on the origin, in units of half its side and
+   a quarter of its height: the four sides, then the bottom and the top */
+static const signed char tile_corners[CHUNK_TILE_VERTICES][3]={
+  {-1,-1,1}, {1,-1,1}, {1,1,1}, {1,1,1}, {-1,1,1}, {-1,-1,1},
+  {1,-1,1}, {1,-1,-1}, {1,1,-1}, {1,1,-1}, {1,1,1}, {1,-1,1},
+  {1,1,-1}, {-1,1,-1}, {-1,-1,-1}, {-1,-1,-1}, {1,-1,-1}, {1,1,-1},
+  {-1,1,-1}, {-1,1,1}, {-1,-1,1}, {-1,-1,1}, {-1,-1,-1}, {-1,1,-1},
+  {-1,-1,1}, {1,-1,1}, {1,-1,-1}, {1,-1,-1}, {-1,-1,-1}, {-1,-1,1},
+  {-1,1,1}, {1,1,1}, {1,1,-1}, {1,1,-1}, {-1,1,-1}, {-1,1,1}
+};
+
+static int comes_and_goes(int t)
+{
+  return t==TILE_BRIDGE || t==TILE_CRUMBLE || t==TILE_TIMED;
+}
+
+static void add_tile(chunk_mesh *m,float x,float y,float z,int type)
+{
+  // the second and fifth vertex of each top/bottom face take the stripe colour
+  static const int face_colour[6]={1,2,1,1,2,1};
+  const float (*palette)[3]=tile_palette[tile_rules[type].palette];
+  int i,k;
+
+  for(i=0;i<CHUNK_TILE_VERTICES;i++)
+  {
+    const float *c=(i<24) ? palette[0] : palette[face_colour[i%6]];
+    m->vertices.push_back(x+tile_corners[i][0]*TILE_SIDE/2);
+    m->vertices.push_back(y+tile_corners[i][1]*TILE_SIDE/4);
+    m->vertices.push_back(z+tile_corners[i][2]*TILE_SIDE/2);
+    for(k=0;k<3;k++)
+      m->colours.push_back(c[k]);
+  }
+}
+
+static void build_mesh(const chunk_cache *c,int chunk,chunk_mesh *m)
+{
+  const level_board *b=c->board;
+  int x0=chunk/c->chunks_z*CHUNK_SIZE,z0=chunk%c->chunks_z*CHUNK_SIZE;
+  int x1=(x0+CHUNK_SIZE<b->width) ? x0+CHUNK_SIZE : b->width;
+  int z1=(z0+CHUNK_SIZE<b->height) ? z0+CHUNK_SIZE : b->height;
+  int pass,x,z;
+
+  m->vertices.clear();
+  m->colours.clear();
+  m->cells.clear();
+  m->fixed=0;
+  for(pass=0;pass<2;pass++)
+  {
+    for(x=x0;x<x1;x++)
+    {
+      for(z=z0;z<z1;z++)
+      {
+        int type=tile_at(b,x,z);
+        if(type==TILE_VOID || comes_and_goes(type)!=pass)
+          continue;
+        add_tile(m,c->x0+x*TILE_SIDE,-0.5f-0.125f,c->z0-z*TILE_SIDE,type);
+        if(pass)
+          m->cells.push_back(x*b->height+z);
+        else
+          m->fixed++;
+      }
+    }
+  }
+}
+
+static void run_builder(chunk_cache *c)
+{
+  std::unique_lock<std::mutex> hold(c->lock);
+
+  for(;;)
+  {
+    while(!c->stopping && c->queue.empty())
+      c->wake.wait(hold);
+    if(c->stopping)
+      return;
+    chunk_slot *s=&c->slots[c->queue.front()];
+    c->queue.pop_front();
+    s->state=CHUNK_BUILDING;
+    hold.unlock();
+    build_mesh(c,s->chunk,&s->mesh);
+    hold.lock();
+    s->state=CHUNK_BUILT;
+    c->wake.notify_all();
+  }
+}
+
+void start_chunks(chunk_cache *c,const level_board *b,float x0,float z0)
+{
+  int i;
+
+  c->board=b;
+  c->x0=x0;
+  c->z0=z0;
+  c->chunks_x=(b->width+CHUNK_SIZE-1)/CHUNK_SIZE;
+  c->chunks_z=(b->height+CHUNK_SIZE-1)/CHUNK_SIZE;
+  c->slots.resize(CHUNK_CACHE);
+  for(i=0;i<CHUNK_CACHE;i++)
+  {
+    c->slots[i].chunk=-1;
+    c->slots[i].state=CHUNK_EMPTY;
+    c->slots[i].wanted=0;
+    c->slots[i].gpu=NULL;
+  }
+  c->slot_of.assign(c->chunks_x*c->chunks_z,-1);
+  c->calls=0;
+  c->queue.clear();
+  c->stopping=0;
+  c->builder=std::thread(run_builder,c);
+}
+
+static void empty_slot(chunk_cache *c,chunk_slot *s,std::vector<void *> *freed)
+{
+  if(s->gpu)
+    freed->push_back(s->gpu);
+  if(s->chunk>=0)
+    c->slot_of[s->chunk]=-1;
+  s->chunk=-1;
+  s->state=CHUNK_EMPTY;
+  s->gpu=NULL;
+  std::vector<float>().swap(s->mesh.vertices);
+  std::vector<float>().swap(s->mesh.colours);
+}
+
+void stop_chunks(chunk_cache *c,std::vector<void *> *freed)
+{
+  size_t i;
+
+  if(c->builder.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> hold(c->lock);
+      c->stopping=1;
+    }
+    c->wake.notify_all();
+    c->builder.join();
+  }
+  for(i=0;i<c->slots.size();i++)
+    empty_slot(c,&c->slots[i],freed);
+  c->queue.clear();
+}
+
+/* A slot for a chunk just wanted: an empty one, else the one wanted least
+   recently that isn't wanted now or being built; -1 if there is none */
+static int free_slot(chunk_cache *c,std::vector<void *> *freed)
+{
+  int best=-1,i;
+
+  for(i=0;i<CHUNK_CACHE;i++)
+  {
+    const chunk_slot *s=&c->slots[i];
+    if(s->state==CHUNK_EMPTY)
+      return i;
+    if(s->state!=CHUNK_BUILDING && s->wanted<c->calls && (best<0 || s->wanted<c->slots[best].wanted))
+      best=i;
+  }
+  if(best>=0)
+    empty_slot(c,&c->slots[best],freed);
+  return best;
+}
+
+void want_chunks(chunk_cache *c,int cx,int cz,int radius,std::vector<void *> *freed)
+{
+  std::lock_guard<std::mutex> hold(c->lock);
+  int d,x,z;
+  size_t i;
+
+  c->calls++;
+  c->queue.clear();
+  // ring by ring out from (cx,cz), so the queue is nearest first
+  for(d=0;d<=radius;d++)
+  {
+    for(x=cx-d;x<=cx+d;x++)
+    {
+      for(z=cz-d;z<=cz+d;z++)
+      {
+        if(abs(x-cx)!=d && abs(z-cz)!=d)
+          continue;
+        if(x<0 || z<0 || x>=c->chunks_x || z>=c->chunks_z)
+          continue;
+        int chunk=x*c->chunks_z+z;
+        int n=c->slot_of[chunk];
+        if(n<0)
+        {
+          n=free_slot(c,freed);
+          if(n<0)
+            continue;
+          c->slots[n].chunk=chunk;
+          c->slots[n].state=CHUNK_QUEUED;
+          c->slot_of[chunk]=n;
+        }
+        c->slots[n].wanted=c->calls;
+        if(c->slots[n].state==CHUNK_QUEUED)
+          c->queue.push_back(n);
+      }
+    }
+  }
+  // what was queued before and isn't wanted now is never built
+  for(i=0;i<c->slots.size();i++)
+    if(c->slots[i].state==CHUNK_QUEUED && c->slots[i].wanted<c->calls)
+      empty_slot(c,&c->slots[i],freed);
+  if(!c->queue.empty())
+    c->wake.notify_all();
+}
+
+chunk_slot *built_chunk(chunk_cache *c)
+{
+  std::lock_guard<std::mutex> hold(c->lock);
+  size_t i;
+
+  for(i=0;i<c->slots.size();i++)
+  {
+    if(c->slots[i].state==CHUNK_BUILT)
+    {
+      c->slots[i].state=CHUNK_READY;
+      return &c->slots[i];
+    }
+  }
+  return NULL;
+}
+
+chunk_slot *wait_chunk(chunk_cache *c,int cx,int cz)
+{
+  std::unique_lock<std::mutex> hold(c->lock);
+
+  if(cx<0 || cz<0 || cx>=c->chunks_x || cz>=c->chunks_z || c->slot_of[cx*c->chunks_z+cz]<0)
+    return NULL;
+  chunk_slot *s=&c->slots[c->slot_of[cx*c->chunks_z+cz]];
+  while(s->state==CHUNK_QUEUED || s->state==CHUNK_BUILDING)
+    c->wake.wait(hold);
+  if(s->state!=CHUNK_BUILT)
+    return NULL;
+  s->state=CHUNK_READY;
+  return s;
+}
+
+chunk_slot *ready_chunk(chunk_cache *c,int cx,int cz)
+{
+  std::lock_guard<std::mutex> hold(c->lock);
+
+  if(cx<0 || cz<0 || cx>=c->chunks_x || cz>=c->chunks_z || c->slot_of[cx*c->chunks_z+cz]<0)
+    return NULL;
+  chunk_slot *s=&c->slots[c->slot_of[cx*c->chunks_z+cz]];
+  return (s->state==CHUNK_READY) ? s : NULL;
+}
@@ -0,0 +1,99 @@
+#ifndef CHUNKS_H
+#define CHUNKS_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "board.h"
+
+/*
+ * Streaming board geometry for levels of any size. The board is cut into
+ * CHUNK_SIZE x CHUNK_SIZE chunks of tiles and each frame the game asks for
+ * the chunks around where the camera looks. A background thread builds the
+ * missing ones nearest first, and the game uploads each finished mesh and
+ * draws it with one call. Chunks no longer asked for stay cached until
+ * their slot is needed, least recently wanted first, so rolling back and
+ * forth doesn't rebuild them. There are CHUNK_CACHE slots whatever the
+ * board's size, which bounds the geometry kept and the work done a frame.
+ *
+ * Nothing here calls OpenGL: a slot holds the game's handle of the
+ * uploaded mesh, and the handles of evicted slots are given back to it.
+ */
+#define CHUNK_SIZE 16    // tiles along each side of a chunk
+#define CHUNK_CACHE 64   // chunk slots, built or being built
+
+#define CHUNK_TILE_VERTICES 36   // two triangles a face, six faces
+
+enum {
+  CHUNK_EMPTY=0,
+  CHUNK_QUEUED,      // waiting for the builder
+  CHUNK_BUILDING,
+  CHUNK_BUILT,       // waiting to be uploaded
+  CHUNK_READY
+};
+
+/* A chunk's tiles as triangles, CHUNK_TILE_VERTICES a tile: first the
+   tiles that are always there, then the bridges, crumble and timed tiles
+   that come and go, so the game draws the first lot in one call */
+typedef struct chunk_mesh
+{
+  std::vector<float> vertices;   // x,y,z, emptied once uploaded
+  std::vector<float> colours;    // r,g,b
+  int fixed;                     // tiles always there
+  std::vector<int> cells;        // x*height+z of each tile after them
+}chunk_mesh;
+
+typedef struct chunk_slot
+{
+  int chunk;         // cx*chunks_z+cz, -1 while empty
+  int state;         // CHUNK_*
+  long wanted;       // want_chunks() call that last wanted it
+  chunk_mesh mesh;   // written by the builder until CHUNK_BUILT
+  void *gpu;         // the game's uploaded copy, NULL until then
+}chunk_slot;
+
+typedef struct chunk_cache
+{
+  const level_board *board;        // not changed while the builder runs
+  float x0,z0;                     // where the centre of tile (0,0) is drawn
+  int chunks_x,chunks_z;
+  std::vector<chunk_slot> slots;   // CHUNK_CACHE of them
+  std::vector<int> slot_of;        // slot of every chunk, -1 if none
+  long calls;
+  std::mutex lock;                 // guards the slot states and the queue
+  std::condition_variable wake;
+  std::deque<int> queue;           // slots to build, nearest first
+  int stopping;
+  std::thread builder;
+}chunk_cache;
+
+/* Colours of the tiles, indexed by tile_rules[type].palette: the sides,
+   and the top and bottom faces which are striped with the third colour */
+extern const float tile_palette[NUM_TILES][3][3];
+
+/* Start streaming the chunks of board b's tiles, drawn from (x0,z0) as
+   the game draws them; stop_chunks() any level streamed before first */
+void start_chunks(chunk_cache *c,const level_board *b,float x0,float z0);
+
+/* Stop the builder and empty every slot, adding the game's handles to freed */
+void stop_chunks(chunk_cache *c,std::vector<void *> *freed);
+
+/* Want the chunks within radius of chunk (cx,cz): queue the missing ones
+   nearest first and drop queued ones further away. Slots evicted for them
+   add their handles to freed. */
+void want_chunks(chunk_cache *c,int cx,int cz,int radius,std::vector<void *> *freed);
+
+/* A slot the builder has finished, now CHUNK_READY, or NULL; the game
+   uploads its mesh and sets gpu */
+chunk_slot *built_chunk(chunk_cache *c);
+
+/* Wait for chunk (cx,cz) if it is queued or being built, and return its
+   slot if it is yet to be uploaded, as built_chunk() does */
+chunk_slot *wait_chunk(chunk_cache *c,int cx,int cz);
+
+/* Slot of chunk (cx,cz) if it is ready to draw, else NULL */
+chunk_slot *ready_chunk(chunk_cache *c,int cx,int cz);
+
+#endif
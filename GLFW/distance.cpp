@@ -0,0 +1,234 @@
+#include <algorithm>
+
+#include "distance.h"
+
+/*
+ * Rolls only run forwards through step(), so the build works out the
+ * states a roll before a state from the shape of the rolls, the switches
+ * under the block and the teleports that send it there, and keeps the ones
+ * step() agrees roll into it. Other than the table it keeps a bit for each
+ * 64 slots holding the layer being rolled back from, and one for the next.
+ * A state the block can't rest in may be labelled, which is harmless: the
+ * game never asks for it and nothing rolls into it without falling.
+ */
+
+/* Table slot of s, or -1 if the table doesn't cover it */
+static long slot_of(const distance_table *t,const game_state *s)
+{
+  long sw=0;
+  size_t g;
+
+  if(s->damage)
+    return -1;
+  for(g=0;g<t->groups.size();g++)
+    sw|=(long)((s->switch_check>>t->groups[g])&1)<<g;
+  sw|=(long)s->tick<<t->groups.size();
+  int c=cell_index(&t->board,block_x(s->block),block_z(s->block));
+  return (sw*t->cells+c)*3+block_orient(s->block);
+}
+
+static game_state state_at(const distance_table *t,long i)
+{
+  const level_board *b=&t->board;
+  game_state s;
+  long sw=i/3/t->cells;
+  int c=(i/3)%t->cells;
+  size_t g;
+
+  s.block=pack_block(c/b->stride-BOARD_PAD,c%b->stride-BOARD_PAD,i%3);
+  s.switch_check=0;
+  for(g=0;g<t->groups.size();g++)
+    s.switch_check|=(uint32_t)((sw>>g)&1)<<t->groups[g];
+  s.damage=0;
+  s.tick=sw>>t->groups.size();
+  s.no_of_moves=0;
+  return s;
+}
+
+/* Label with d every state one roll before s that is still DIST_DEAD,
+   flagging its 64-slot block in next; returns how many were labelled */
+static int label_predecessors(distance_table *t,long i,int d,const std::vector<int> &teleports,std::vector<uint64_t> *next)
+{
+  const level_board *b=&t->board;
+  game_state s=state_at(t,i);
+  int o=block_orient(s.block),standing=(o==ORIENT_STANDING);
+  int c0=cell_index(b,block_x(s.block),block_z(s.block));
+  int c1=c0+b->second_cell[o];
+  uint32_t pressed=((uint32_t)presses(b->flags[c0],standing)<<b->group[c0]) |
+      ((uint32_t)presses(b->flags[c1],standing)<<b->group[c1]);
+  int labelled=0,k;
+
+  // the block came to rest where s has it, or on a teleport sending it there
+  for(k=-1;k<(int)teleports.size();k++)
+  {
+    uint32_t landing=s.block;
+    if(k>=0)
+    {
+      if(!standing || b->target[teleports[k]]!=s.block)
+        continue;
+      landing=pack_block(teleports[k]/b->stride-BOARD_PAD,teleports[k]%b->stride-BOARD_PAD,ORIENT_STANDING);
+    }
+    int lo=block_orient(landing),dir,po,toggled;
+    for(dir=0;dir<NUM_DIRS;dir++)
+    {
+      for(po=0;roll_orient[po][dir]!=lo;po++)
+        ;
+      int x=block_x(landing)-roll_dx[po][dir];
+      int z=block_z(landing)-roll_dz[po][dir];
+      if(x<-BOARD_PAD || z<-BOARD_PAD || x>=b->width+BOARD_PAD || z>=b->height+BOARD_PAD)
+        continue;
+      // the switches under s were pressed on the way in, or weren't
+      for(toggled=0;toggled<=(pressed!=0);toggled++)
+      {
+        game_state p=s,q;
+        p.block=pack_block(x,z,po);
+        p.switch_check=s.switch_check^(toggled ? pressed : 0);
+        p.tick=(s.tick+b->period-1)%b->period;
+        long j=slot_of(t,&p);
+        if(t->dist[j]!=DIST_DEAD)
+          continue;
+        q=p;
+        if(step(b,&q,dir)==MOVE_FALL || q.block!=s.block || q.switch_check!=s.switch_check || q.tick!=s.tick)
+          continue;
+        t->dist[j]=d;
+        (*next)[j>>12]|=1ull<<((j>>6)&63);
+        labelled++;
+      }
+    }
+  }
+  return labelled;
+}
+
+static void build(distance_table *t)
+{
+  const level_board *b=&t->board;
+  long size=t->dist.size(),i;
+  std::vector<uint64_t> layer((size+4095)>>12,0);   // a bit per 64 slots holding the layer
+  std::vector<uint64_t> next(layer.size(),0);
+  std::vector<int> teleports;
+  int c,d;
+  size_t w;
+
+  for(c=0;c<t->cells;c++)
+    if(b->flags[c]&TF_TELEPORT)
+      teleports.push_back(c);
+
+  // layer 0: standing on the goal, whatever the switches and the tick
+  for(c=0;c<t->cells;c++)
+  {
+    if(!(b->flags[c]&TF_GOAL))
+      continue;
+    for(i=c*3+ORIENT_STANDING;i<size;i+=3L*t->cells)
+    {
+      t->dist[i]=0;
+      layer[i>>12]|=1ull<<((i>>6)&63);
+    }
+  }
+
+  // then a layer at a time, the layer's states found by scanning the
+  // flagged blocks for its distance; past DIST_FAR every state is DIST_FAR,
+  // so the blocks are scanned for any until no more are labelled
+  for(d=0;;d++)
+  {
+    int here=(d<DIST_FAR) ? d : DIST_FAR;
+    int there=(d+1<DIST_FAR) ? d+1 : DIST_FAR;
+    long labelled=0;
+    for(w=0;w<layer.size();w++)
+    {
+      if(t->cancel.load(std::memory_order_relaxed))
+        return;
+      uint64_t bits;
+      for(bits=layer[w];bits;bits&=bits-1)
+      {
+        long first=((long)w<<12)|(long)__builtin_ctzll(bits)<<6;
+        long last=(first+64<size) ? first+64 : size;
+        for(i=first;i<last;i++)
+          if(t->dist[i]==here)
+            labelled+=label_predecessors(t,i,there,teleports,&next);
+      }
+    }
+    if(!labelled)
+      break;
+    layer.swap(next);
+    std::fill(next.begin(),next.end(),0);
+  }
+  t->status.store(DIST_READY,std::memory_order_release);
+}
+
+void stop_distances(distance_table *t)
+{
+  if(t->builder.joinable())
+  {
+    t->cancel.store(1);
+    t->builder.join();
+  }
+}
+
+void start_distances(distance_table *t,const level_board *b)
+{
+  int g;
+
+  stop_distances(t);
+  t->status.store(DIST_BUILDING);
+  t->cancel.store(0);
+  t->board=*b;
+  t->cells=b->tiles.size();
+  t->groups.clear();
+
+  uint32_t used=0;
+  size_t i;
+  for(i=0;i<b->tiles.size();i++)
+    if(b->flags[i]&TF_SWITCH)
+      used|=1u<<b->group[i];
+  for(g=0;g<MAX_GROUPS;g++)
+    if((used>>g)&1)
+      t->groups.push_back(g);
+
+  long size=3L*t->cells*b->period;
+  for(i=0;i<t->groups.size() && size<=DIST_MAX_BYTES;i++)
+    size*=2;
+  if(b->crumble_count || size>DIST_MAX_BYTES)
+  {
+    t->dist.clear();
+    t->status.store(DIST_NONE);
+    return;
+  }
+  t->dist.assign(size,DIST_DEAD);
+
+  t->builder=std::thread(build,t);
+}
+
+int distance_to_goal(const distance_table *t,const game_state *s)
+{
+  if(t->status.load(std::memory_order_acquire)!=DIST_READY)
+    return -1;
+  long i=slot_of(t,s);
+  if(i<0 || t->dist[i]==DIST_FAR)
+    return -1;
+  return t->dist[i];
+}
+
+int best_roll(const distance_table *t,const game_state *s)
+{
+  int best=-1,best_dist=DIST_DEAD;
+  int dir;
+
+  if(t->status.load(std::memory_order_acquire)!=DIST_READY)
+    return -1;
+  for(dir=0;dir<NUM_DIRS;dir++)
+  {
+    game_state next=*s;
+    int outcome=step(&t->board,&next,dir);
+    if(outcome==MOVE_GOAL)
+      return dir;
+    if(outcome==MOVE_FALL)
+      continue;
+    int d=distance_to_goal(t,&next);
+    if(d>=0 && d<best_dist)
+    {
+      best=dir;
+      best_dist=d;
+    }
+  }
+  return best;
+}
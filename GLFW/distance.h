@@ -0,0 +1,60 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <atomic>
+#include <thread>
+
+#include "rules.h"
+
+/*
+ * Rolls to the goal from every state, one byte per (tick, switch groups,
+ * cell, orientation), built by a backward BFS from the goal that keeps
+ * nothing a state but the byte itself. The game starts a build when a
+ * level loads and uses the table once it is ready: a hint is the roll to
+ * the neighbour nearest the goal, and a state with no way to the goal can
+ * be flagged as soon as the block gets there. Loading another level
+ * cancels a build still running.
+ *
+ * Levels with crumble tiles, whose states also carry the damage, or with
+ * too many switch groups for the table get no table. Distances of
+ * DIST_FAR rolls or more aren't told apart, so the table gives no hint
+ * that far from the goal.
+ */
+#define DIST_FAR 254     // this many rolls or more
+#define DIST_DEAD 255    // the goal can't be reached
+
+#define DIST_MAX_BYTES (1<<26)
+
+enum {
+  DIST_BUILDING=0,
+  DIST_READY=1,
+  DIST_NONE=-1      // the level can't have a table
+};
+
+typedef struct distance_table
+{
+  level_board board;                // own copy, so the game's board can change meanwhile
+  int cells;
+  std::vector<int> groups;          // switch groups in table order
+  std::vector<unsigned char> dist;
+  std::atomic<int> status;          // DIST_*, set last by the builder
+  std::atomic<int> cancel;          // set to make the builder give up
+  std::thread builder;
+}distance_table;
+
+/* Rebuild t for board b on a background thread, cancelling any build
+   still running first */
+void start_distances(distance_table *t,const level_board *b);
+
+/* Cancel a running build and wait for its thread to end */
+void stop_distances(distance_table *t);
+
+/* Rolls from s to the goal, DIST_DEAD if there are none, or -1 while the
+   table isn't ready, doesn't cover s or has s DIST_FAR or more away */
+int distance_to_goal(const distance_table *t,const game_state *s);
+
+/* DIR_* of a roll on a shortest way to the goal from s, or -1 if there is
+   none or the table can't tell */
+int best_roll(const distance_table *t,const game_state *s);
+
+#endif
@@ -0,0 +1,763 @@
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "search.h"
+
+/*
+ * The tables hold every state with both cells of the block on the board,
+ * reachable or not, so an edit that opens up a new part of the level
+ * needs no new states. next[] holds where each roll u*NUM_DIRS+dir leads.
+ * The rolls into a state aren't stored: they can only come from the few
+ * cells a roll lands on it from, or from teleports onto it, in the state
+ * it has with whatever the landing pressed toggled back, the crumble tiles
+ * it landed on unbroken and the tick before, so they are those candidates
+ * whose next[] still leads there.
+ *
+ * Whether a roll falls, where it ends up and which switches it presses
+ * only depends on the tiles it lands on, so changing cell c only changes
+ * the rolls landing on a block covering c, and those landing on a
+ * teleport that sends the block onto c. Those are rolled again with
+ * step(), and the distances are kept the way Koenig and Likhachev's
+ * Lifelong Planning A* does: rhs[] is what a state's dist would be from
+ * its rolls as they stand, states where the two differ wait in a queue,
+ * and they are settled nearest first until none left can change the
+ * start's distance. Nearness counts the rolls each may be from the start,
+ * at least half the cells its block is off the start's, so an edit far
+ * from the start's way to the goal barely settles anything now and what
+ * it left behind is settled only when a later edit needs it. A teleport
+ * can put the block anywhere, so with any on the board that count is left
+ * out and the queue goes by distance alone.
+ *
+ * A state's switch bits, damage bits and tick make up its plane, one
+ * digit per dimension of dims. An edit that brings in a group, a crumble
+ * tile or a tick the tables lack adds a dimension on the outside: the
+ * tables are copied once for each value of the new digit, which nothing
+ * read before the edit, so every copy has the same distances and the same
+ * states queued, and a roll stays in its copy, or for the tick moves on to
+ * the next. Then the edit is settled like any other. A crumble tile takes over the damage bit of
+ * one that was removed before a new dimension is added for it.
+ */
+
+/* States are numbered by plane, then cell, then orientation, so a new
+   outermost dimension leaves the numbers of the old states alone */
+static inline long slot(const edit_search *e,int c,long plane,int o)
+{
+  return (plane*e->cells+c)*3+o;
+}
+
+static inline int cell_of(const edit_search *e,long i)
+{
+  return (i/3)%e->cells;
+}
+
+static inline long plane_of(const edit_search *e,long i)
+{
+  return (i/3)/e->cells;
+}
+
+/* The value of dimension d in s */
+static inline long digit_of(const edit_dim *d,const game_state *s)
+{
+  if(d->kind==EDIT_DIM_GROUP)
+    return (s->switch_check>>d->id)&1;
+  if(d->kind==EDIT_DIM_DAMAGE)
+    return (s->damage>>d->id)&1;
+  return s->tick;
+}
+
+static long slot_of(const edit_search *e,const game_state *s)
+{
+  long plane=0;
+  size_t d;
+
+  for(d=0;d<e->dims.size();d++)
+    plane+=digit_of(&e->dims[d],s)*e->dims[d].stride;
+  return slot(e,cell_index(&e->board,block_x(s->block),block_z(s->block)),plane,block_orient(s->block));
+}
+
+static game_state state_at(const edit_search *e,long i)
+{
+  const level_board *b=&e->board;
+  game_state s;
+  long plane=plane_of(e,i);
+  int c=cell_of(e,i);
+  size_t d;
+
+  s.block=pack_block(c/b->stride-BOARD_PAD,c%b->stride-BOARD_PAD,i%3);
+  s.switch_check=0;
+  s.damage=0;
+  s.tick=0;
+  s.no_of_moves=0;
+  for(d=0;d<e->dims.size();d++)
+  {
+    const edit_dim *m=&e->dims[d];
+    uint32_t v=plane/m->stride%m->size;
+    if(m->kind==EDIT_DIM_GROUP)
+      s.switch_check|=v<<m->id;
+    else if(m->kind==EDIT_DIM_DAMAGE)
+      s.damage|=v<<m->id;
+    else
+      s.tick=v;
+  }
+  return s;
+}
+
+/* Are both cells of a block at (x,z) lying along o on the board? */
+static int on_board(const level_board *b,int x,int z,int o)
+{
+  int x1=x+(o==ORIENT_LYING_X);
+  int z1=z+(o==ORIENT_LYING_Z);
+
+  return x>=0 && z>=0 && x1<b->width && z1<b->height;
+}
+
+/* Where roll r leads now */
+static int32_t roll_to(const edit_search *e,long r)
+{
+  game_state s=state_at(e,r/NUM_DIRS);
+  int outcome=step(&e->board,&s,r%NUM_DIRS);
+
+  if(outcome==MOVE_FALL)
+    return EDGE_FALL;
+  if(outcome==MOVE_GOAL)
+    return EDGE_GOAL;
+  return slot_of(e,&s);
+}
+
+/* Digit d of plane moved by step values, wrapping round */
+static inline long move_digit(const edit_search *e,long plane,int d,int step)
+{
+  const edit_dim *m=&e->dims[d];
+  long digit=plane/m->stride%m->size;
+
+  return plane+(((digit+step+m->size)%m->size)-digit)*m->stride;
+}
+
+/* The plane of the state a roll landed from to end up in plane along o
+   on cell c, -1 if no roll can: the switches the landing pressed toggled
+   back, the crumble tiles it landed on unbroken and the tick one back */
+static long plane_before(const edit_search *e,int c0,long plane,int o)
+{
+  const level_board *b=&e->board;
+  int c1=c0+b->second_cell[o];
+  unsigned f0=b->flags[c0],f1=b->flags[c1];
+  int standing=(o==ORIENT_STANDING);
+
+  if((f0|f1)&(TF_SWITCH|TF_CRUMBLE))
+  {
+    uint32_t pressed=((uint32_t)presses(f0,standing)<<b->group[c0]) |
+        ((uint32_t)presses(f1,standing)<<b->group[c1]);
+    uint32_t landed=((f0&TF_CRUMBLE) ? 1u<<b->group[c0] : 0) |
+        ((f1&TF_CRUMBLE) ? 1u<<b->group[c1] : 0);
+    for(;pressed;pressed&=pressed-1)
+    {
+      int d=e->group_dim[__builtin_ctz(pressed)];
+      if(d>=0)
+        plane=move_digit(e,plane,d,1);
+    }
+    for(;landed;landed&=landed-1)
+    {
+      int d=e->damage_dim[__builtin_ctz(landed)];
+      if(d<0)
+        continue;
+      if(plane/e->dims[d].stride%2==0)
+        return -1;
+      plane-=e->dims[d].stride;
+    }
+  }
+  if(e->tick_dim>=0)
+    plane=move_digit(e,plane,e->tick_dim,-1);
+  return plane;
+}
+
+/* Add the rolls from plane that land on cell c along o and lead to state
+   v. The block rolls at most two cells, so the cells they start from are
+   at worst in the padding, where every roll falls. */
+static void rolls_landing(const edit_search *e,int c,int o,long plane,long v,std::vector<int32_t> *into)
+{
+  int stride=e->board.stride;
+  int o0,dir;
+
+  for(o0=0;o0<3;o0++)
+  {
+    for(dir=0;dir<NUM_DIRS;dir++)
+    {
+      if(roll_orient[o0][dir]!=o)
+        continue;
+      long r=slot(e,c-roll_dx[o0][dir]*stride-roll_dz[o0][dir],plane,o0)*NUM_DIRS+dir;
+      if(e->next[r]==v)
+        into->push_back(r);
+    }
+  }
+}
+
+/* The rolls into state v */
+static void rolls_into(const edit_search *e,long v,std::vector<int32_t> *into)
+{
+  int o=v%3;
+  long q=v/3;
+  long plane=q/e->cells;
+  int c=q-plane*e->cells;
+  size_t i;
+
+  plane=plane_before(e,c,plane,o);
+
+  into->clear();
+  if(plane<0)
+    return;
+  rolls_landing(e,c,o,plane,v,into);
+  if(o!=ORIENT_STANDING)
+    return;
+  for(i=0;i<e->teleports.size();i++)
+    if(e->teleport_to[i]==c && e->teleports[i]!=c)
+      rolls_landing(e,e->teleports[i],o,plane,v,into);
+}
+
+/* Fewest rolls to the goal from u through the distances as they stand */
+static int32_t best_dist(const edit_search *e,long u)
+{
+  int32_t best=EDIT_NO_WAY;
+  int dir;
+
+  for(dir=0;dir<NUM_DIRS;dir++)
+  {
+    int32_t to=e->next[u*NUM_DIRS+dir];
+    if(to==EDGE_GOAL)
+      return 1;
+    if(to>=0 && e->dist[to]+1<best)
+      best=e->dist[to]+1;
+  }
+  return best;
+}
+
+/* Fewest rolls the block can be from the start in u, going by the cells
+   one roll moves the anchor of a block, which is at most two */
+static inline int32_t from_start(const edit_search *e,long u)
+{
+  const level_board *b=&e->board;
+  int c=cell_of(e,u);
+  int dx=c/b->stride-BOARD_PAD-block_x(e->start.block);
+  int dz=c%b->stride-BOARD_PAD-block_z(e->start.block);
+
+  return (abs(dx)+abs(dz)+1)/2;
+}
+
+static inline edit_entry key_of(const edit_search *e,long u)
+{
+  edit_entry k;
+
+  k.dist=std::min(e->dist[u],e->rhs[u]);
+  k.key=(k.dist==EDIT_NO_WAY) ? EDIT_NO_WAY : k.dist+(e->guided ? from_start(e,u) : 0);
+  k.state=u;
+  return k;
+}
+
+/* Does a come after b in the queue? As the heap's order, puts the first
+   at the front. */
+static inline bool later(const edit_entry &a,const edit_entry &b)
+{
+  return a.key>b.key || (a.key==b.key && a.dist>b.dist);
+}
+
+static void enqueue(edit_search *e,long u)
+{
+  e->queue.push_back(key_of(e,u));
+  std::push_heap(e->queue.begin(),e->queue.end(),later);
+}
+
+/* Work out rhs[u] again, queueing u if it now differs from dist[u] */
+static void recheck(edit_search *e,long u)
+{
+  e->rhs[u]=best_dist(e,u);
+  if(e->rhs[u]!=e->dist[u])
+    enqueue(e,u);
+}
+
+/* The queue made again from every state whose dist and rhs differ, after
+   the keys changed or the states were renumbered */
+static void requeue(edit_search *e)
+{
+  long u,states=e->dist.size();
+
+  e->guided=e->teleports.empty();
+  e->queue.clear();
+  for(u=0;u<states;u++)
+    if(e->dist[u]!=e->rhs[u])
+      e->queue.push_back(key_of(e,u));
+  std::make_heap(e->queue.begin(),e->queue.end(),later);
+}
+
+/* Settle queued states, nearest first, until the start's distance is
+   right */
+static void settle(edit_search *e)
+{
+  long s=slot_of(e,&e->start);
+  std::vector<int32_t> into;
+  size_t r;
+
+  e->repaired=0;
+  while(!e->queue.empty())
+  {
+    edit_entry top=e->queue.front();
+    if(!later(key_of(e,s),top) && e->dist[s]==e->rhs[s])
+      break;
+    std::pop_heap(e->queue.begin(),e->queue.end(),later);
+    e->queue.pop_back();
+    long u=top.state;
+    edit_entry k=key_of(e,u);
+    // left behind by an entry since, or already settled
+    if(e->dist[u]==e->rhs[u] || k.key!=top.key || k.dist!=top.dist)
+      continue;
+    e->repaired++;
+    rolls_into(e,u,&into);
+    if(e->rhs[u]<e->dist[u])
+    {
+      e->dist[u]=e->rhs[u];
+      for(r=0;r<into.size();r++)
+      {
+        long p=into[r]/NUM_DIRS;
+        if(e->dist[u]+1<e->rhs[p])
+        {
+          e->rhs[p]=e->dist[u]+1;
+          if(e->rhs[p]!=e->dist[p])
+            enqueue(e,p);
+        }
+      }
+    }
+    else
+    {
+      // further than it was: those it was the best roll for look again
+      int32_t was=e->dist[u];
+      e->dist[u]=EDIT_NO_WAY;
+      recheck(e,u);
+      for(r=0;r<into.size();r++)
+      {
+        long p=into[r]/NUM_DIRS;
+        if(e->rhs[p]==was+1)
+          recheck(e,p);
+      }
+    }
+  }
+}
+
+static int start_moves(const edit_search *e)
+{
+  int32_t d=e->dist[slot_of(e,&e->start)];
+
+  return (d==EDIT_NO_WAY) ? -1 : d;
+}
+
+/* Switch groups with a tile of any of the kinds in flags in them, as a
+   bit per group */
+static uint32_t used_groups(const level_board *b,unsigned flags)
+{
+  uint32_t used=0;
+  size_t i;
+
+  for(i=0;i<b->tiles.size();i++)
+    if(b->flags[i]&flags)
+      used|=1u<<b->group[i];
+  return used;
+}
+
+/* Groups whose bit changes what the block can do: those with a switch to
+   work their bridges and a bridge to be worked. A group lacking either
+   leaves every state alike whatever its bit. */
+static uint32_t needed_groups(const level_board *b)
+{
+  return used_groups(b,TF_SWITCH)&used_groups(b,TF_BRIDGE);
+}
+
+/* Is a crumble tile other than the one at cell skip breaking with damage
+   bit k? */
+static int damage_used(const level_board *b,int k,int skip)
+{
+  const bitboard &m=b->mask[TILE_CRUMBLE];
+  size_t i;
+
+  for(i=0;i<m.size();i++)
+  {
+    uint64_t w=m[i];
+    while(w)
+    {
+      int c=i*64+__builtin_ctzll(w);
+      if(c!=skip && b->group[c]==k)
+        return 1;
+      w&=w-1;
+    }
+  }
+  return 0;
+}
+
+static int has_timed(const level_board *b)
+{
+  const bitboard &m=b->mask[TILE_TIMED];
+  size_t i;
+
+  for(i=0;i<m.size();i++)
+    if(m[i])
+      return 1;
+  return 0;
+}
+
+static void find_teleports(edit_search *e)
+{
+  const bitboard &m=e->board.mask[TILE_TELEPORT];
+  size_t i;
+
+  e->teleports.clear();
+  e->teleport_to.clear();
+  for(i=0;i<m.size();i++)
+  {
+    uint64_t w=m[i];
+    while(w)
+    {
+      int c=i*64+__builtin_ctzll(w);
+      uint32_t to=e->board.target[c];
+      e->teleports.push_back(c);
+      e->teleport_to.push_back(cell_index(&e->board,block_x(to),block_z(to)));
+      w&=w-1;
+    }
+  }
+}
+
+/* Note a dimension as the outermost, without touching the tables */
+static void add_dim(edit_search *e,int kind,int id,int size)
+{
+  edit_dim d;
+
+  d.kind=kind;
+  d.id=id;
+  d.size=size;
+  d.stride=e->planes;
+  e->planes*=size;
+  if(kind==EDIT_DIM_GROUP)
+    e->group_dim[id]=e->dims.size();
+  else if(kind==EDIT_DIM_DAMAGE)
+    e->damage_dim[id]=e->dims.size();
+  else
+    e->tick_dim=e->dims.size();
+  e->dims.push_back(d);
+}
+
+static void clear_dims(edit_search *e)
+{
+  int i;
+
+  e->dims.clear();
+  e->planes=1;
+  e->tick_dim=-1;
+  for(i=0;i<MAX_GROUPS;i++)
+    e->group_dim[i]=-1;
+  for(i=0;i<MAX_CRUMBLE;i++)
+    e->damage_dim[i]=-1;
+}
+
+/* Solve e->board from scratch into the tables, or with solve_bfs() if it
+   can't have them */
+static void rebuild(edit_search *e)
+{
+  const level_board *b=&e->board;
+  uint32_t needed=needed_groups(b);
+  // and while there is room, the groups an edit may yet make needed: any
+  // with a switch or a bridge, and group 0 that new tiles start in
+  uint32_t spare=(used_groups(b,TF_SWITCH|TF_BRIDGE)|1u)&~needed;
+  long states,u,r;
+  int g,c;
+
+  // a tick the tables were still counting without a timed tile left
+  if(!has_timed(b))
+    e->board.period=1;
+  e->cells=b->tiles.size();
+  clear_dims(e);
+  if(b->period>1)
+    add_dim(e,EDIT_DIM_TICK,0,b->period);
+  for(g=0;g<MAX_GROUPS;g++)
+    if((needed>>g)&1)
+      add_dim(e,EDIT_DIM_GROUP,g,2);
+  for(c=0;c<e->cells;c++)
+    if(b->tiles[c]==TILE_CRUMBLE && e->damage_dim[b->group[c]]<0)
+      add_dim(e,EDIT_DIM_DAMAGE,b->group[c],2);
+  for(g=0;g<MAX_GROUPS && 3L*e->cells*e->planes*2<=EDIT_MAX_STATES;g++)
+    if((spare>>g)&1)
+      add_dim(e,EDIT_DIM_GROUP,g,2);
+  states=3L*e->cells*e->planes;
+  find_teleports(e);
+  e->tracked=states<=EDIT_MAX_STATES;
+  if(!e->tracked)
+  {
+    solve_result result;
+    std::vector<int32_t>().swap(e->next);
+    std::vector<int32_t>().swap(e->dist);
+    std::vector<int32_t>().swap(e->rhs);
+    std::vector<edit_entry>().swap(e->queue);
+    solve_bfs(b,&e->start,&result);
+    e->moves=result.moves;
+    e->repaired=result.states;
+    return;
+  }
+
+  e->next.assign(states*NUM_DIRS,EDGE_FALL);
+  e->dist.assign(states,EDIT_NO_WAY);
+  for(u=0;u<states;u++)
+  {
+    int c=cell_of(e,u);
+    if(!on_board(b,c/b->stride-BOARD_PAD,c%b->stride-BOARD_PAD,u%3))
+      continue;
+    for(r=u*NUM_DIRS;r<(u+1)*NUM_DIRS;r++)
+      e->next[r]=roll_to(e,r);
+  }
+
+  // breadth-first back from the states a roll from the goal
+  std::vector<int32_t> queue,into;
+  size_t head,i;
+  for(r=0;r<states*NUM_DIRS;r++)
+  {
+    if(e->next[r]==EDGE_GOAL && e->dist[r/NUM_DIRS]!=1)
+    {
+      e->dist[r/NUM_DIRS]=1;
+      queue.push_back(r/NUM_DIRS);
+    }
+  }
+  for(head=0;head<queue.size();head++)
+  {
+    int32_t v=queue[head];
+    rolls_into(e,v,&into);
+    for(i=0;i<into.size();i++)
+    {
+      u=into[i]/NUM_DIRS;
+      if(e->dist[u]==EDIT_NO_WAY)
+      {
+        e->dist[u]=e->dist[v]+1;
+        queue.push_back(u);
+      }
+    }
+  }
+  e->rhs=e->dist;
+  e->guided=e->teleports.empty();
+  e->queue.clear();
+  e->repaired=queue.size();
+  e->moves=start_moves(e);
+}
+
+void edit_start(edit_search *e,const level_board *b,const game_state *start)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+
+  e->board=*b;
+  e->start=*start;
+  e->start.no_of_moves=0;
+  rebuild(e);
+  e->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+/* Add a dimension of size values on the outside, the tables copied into
+   each; see the comment at the top. Returns 0 if they would be too big. */
+static int grow(edit_search *e,int kind,int id,int size)
+{
+  long states=e->dist.size(),rolls=states*NUM_DIRS,r;
+  int k;
+
+  size_t queued=e->queue.size(),i;
+
+  if(states*size>EDIT_MAX_STATES)
+    return 0;
+  e->next.resize(rolls*size);
+  e->dist.resize(states*size);
+  e->rhs.resize(states*size);
+  // copy 0 last, as it is also the source
+  for(k=size-1;k>=0;k--)
+  {
+    long to=((kind==EDIT_DIM_TICK) ? (k+1)%size : k)*states;
+    for(r=0;r<rolls;r++)
+    {
+      int32_t n=e->next[r];
+      e->next[k*rolls+r]=(n>=0) ? n+to : n;
+    }
+    if(k==0)
+      continue;
+    std::copy(e->dist.begin(),e->dist.begin()+states,e->dist.begin()+k*states);
+    std::copy(e->rhs.begin(),e->rhs.begin()+states,e->rhs.begin()+k*states);
+    // each copy waits to be settled like the first, on the same keys
+    for(i=0;i<queued;i++)
+    {
+      edit_entry q=e->queue[i];
+      q.state+=k*states;
+      e->queue.push_back(q);
+    }
+  }
+  std::make_heap(e->queue.begin(),e->queue.end(),later);
+  add_dim(e,kind,id,size);
+  return 1;
+}
+
+/* Drop the outermost dimensions while nothing reads them any more,
+   keeping the first copy. A dropped tick leaves the rolls of the copy kept
+   leading into it, where the dist they see may differ, so its rhs[] are
+   worked out again. */
+static void shrink(edit_search *e)
+{
+  level_board *b=&e->board;
+  int dropped=0,ticked=0;
+  long u;
+
+  while(!e->dims.empty())
+  {
+    const edit_dim &d=e->dims.back();
+    if(d.kind==EDIT_DIM_GROUP || (d.kind==EDIT_DIM_DAMAGE && damage_used(b,d.id,-1)) ||
+        (d.kind==EDIT_DIM_TICK && has_timed(b)))
+      break;
+    long states=e->dist.size()/d.size,r;
+    for(r=0;r<states*NUM_DIRS;r++)
+      if(e->next[r]>=0)
+        e->next[r]%=states;
+    e->next.resize(states*NUM_DIRS);
+    e->dist.resize(states);
+    e->rhs.resize(states);
+    e->planes/=d.size;
+    if(d.kind==EDIT_DIM_DAMAGE)
+      e->damage_dim[d.id]=-1;
+    else
+    {
+      e->tick_dim=-1;
+      b->period=1;
+      ticked=1;
+    }
+    e->dims.pop_back();
+    dropped=1;
+  }
+  if(ticked)
+    for(u=0;u<(long)e->dist.size();u++)
+      e->rhs[u]=best_dist(e,u);
+  if(dropped)
+    requeue(e);
+}
+
+/* Roll again every roll landing on (x,z) along o, from each plane, and
+   add the states whose rolls changed to changed */
+static void roll_again(edit_search *e,int x,int z,int o,std::vector<int32_t> *changed)
+{
+  const level_board *b=&e->board;
+  long plane;
+  int o0,dir;
+
+  for(o0=0;o0<3;o0++)
+  {
+    for(dir=0;dir<NUM_DIRS;dir++)
+    {
+      int ux=x-roll_dx[o0][dir];
+      int uz=z-roll_dz[o0][dir];
+      if(roll_orient[o0][dir]!=o || !on_board(b,ux,uz,o0))
+        continue;
+      for(plane=0;plane<e->planes;plane++)
+      {
+        long u=slot(e,cell_index(b,ux,uz),plane,o0);
+        long r=u*NUM_DIRS+dir;
+        int32_t to=roll_to(e,r);
+        if(to!=e->next[r])
+        {
+          e->next[r]=to;
+          changed->push_back(u);
+        }
+      }
+    }
+  }
+}
+
+/* Roll again every block covering cell c, and teleports onto it */
+static void roll_cell_again(edit_search *e,int c,std::vector<int32_t> *changed)
+{
+  const level_board *b=&e->board;
+  int x=c/b->stride-BOARD_PAD,z=c%b->stride-BOARD_PAD;
+  size_t i;
+
+  roll_again(e,x,z,ORIENT_STANDING,changed);
+  roll_again(e,x,z,ORIENT_LYING_X,changed);
+  roll_again(e,x-1,z,ORIENT_LYING_X,changed);
+  roll_again(e,x,z,ORIENT_LYING_Z,changed);
+  roll_again(e,x,z-1,ORIENT_LYING_Z,changed);
+  for(i=0;i<e->teleports.size();i++)
+  {
+    int t=e->teleports[i];
+    if(e->teleport_to[i]==c && t!=c)
+      roll_again(e,t/b->stride-BOARD_PAD,t%b->stride-BOARD_PAD,ORIENT_STANDING,changed);
+  }
+}
+
+int edit_tile(edit_search *e,int x,int z,int tile)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  level_board *b=&e->board;
+  std::vector<int32_t> changed;
+  std::vector<int> cells;   // whose rolls to roll again
+  size_t i,k;
+  int g,grown=1;
+
+  if(x<0 || z<0 || x>=b->width || z>=b->height)
+    return e->moves;
+  int c=cell_index(b,x,z);
+  int old=b->tiles[c];
+  int period=b->period;
+  set_tile(b,x,z,tile);
+  if(old==TILE_TELEPORT || tile==TILE_TELEPORT)
+    find_teleports(e);
+  cells.push_back(c);
+
+  if(e->tracked)
+  {
+    // the tables go on counting ticks until the tick is dropped
+    if(b->period<period)
+      b->period=period;
+    else if(b->period>period)
+      grown=(period==1) && grow(e,EDIT_DIM_TICK,0,b->period);
+
+    // a new crumble tile takes a damage bit no tile breaks with any more
+    if(grown && b->tiles[c]==TILE_CRUMBLE && b->tiles[c]!=old)
+    {
+      for(k=0;k<e->dims.size();k++)
+        if(e->dims[k].kind==EDIT_DIM_DAMAGE && !damage_used(b,e->dims[k].id,c))
+          break;
+      if(k<e->dims.size())
+      {
+        b->group[c]=e->dims[k].id;
+        b->crumble_count--;
+      }
+      else
+        grown=grow(e,EDIT_DIM_DAMAGE,b->group[c],2);
+    }
+
+    // a group with a switch and a bridge now, whose switches and bridges
+    // the copies don't tell apart yet
+    uint32_t needed=needed_groups(b);
+    for(g=0;grown && g<MAX_GROUPS;g++)
+    {
+      if(!((needed>>g)&1) || e->group_dim[g]>=0)
+        continue;
+      grown=grow(e,EDIT_DIM_GROUP,g,2);
+      for(k=0;k<b->tiles.size();k++)
+        if((b->flags[k]&(TF_SWITCH|TF_BRIDGE)) && b->group[k]==g)
+          cells.push_back(k);
+    }
+  }
+
+  if(!e->tracked || !grown)
+    rebuild(e);
+  else
+  {
+    for(i=0;i<cells.size();i++)
+      roll_cell_again(e,cells[i],&changed);
+    for(i=0;i<changed.size();i++)
+      recheck(e,changed[i]);
+    shrink(e);
+    // a teleport come or gone changes the keys, and a queue full of
+    // entries left behind is made again
+    if(e->guided!=(int)e->teleports.empty() || e->queue.size()>e->dist.size())
+      requeue(e);
+    settle(e);
+    e->moves=start_moves(e);
+  }
+  e->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+  return e->moves;
+}
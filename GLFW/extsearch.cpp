@@ -0,0 +1,587 @@
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "search.h"
+
+/*
+ * Breadth-first search with the layers on disk, for state spaces too big
+ * to hold. Under the search directory:
+ *
+ *   layer-N      the states first reached in N rolls, sorted
+ *   older        every layer before the last two, sorted, merged into
+ *                one file (only on boards where rolls can't be undone)
+ *   run-N        successors of the layer being expanded, sorted in RAM a
+ *                buffer at a time
+ *   checkpoint   how many layers are complete, for resuming
+ *
+ * Expanding layer N writes its successors as sorted runs, then one merge
+ * of the runs against layers N and N-1 (and older) writes layer N+1, so
+ * every file is read and written front to back in large chunks. When
+ * there are more runs than the memory holds chunks of MERGE_CHUNK states
+ * for, they are first merged a few at a time into longer runs.
+ *
+ * A state is 16 bytes: the switch bits, block word, damage bits and tick.
+ *
+ * On boards of plain, fragile and goal tiles every roll can be rolled
+ * back, so a state's successors are in the layer before it, its own or the
+ * next, and the last two layers are all duplicates can come from. Switches
+ * retract bridges behind the block, teleports and crumbling tiles are one
+ * way, and there a pressed switch can bring a state back four or more
+ * layers on, so those boards also keep the older file. So do boards with
+ * timed tiles, where a roll back lands on a later tick.
+ */
+
+#define EXT_MAGIC 0x5842584fu   // "OXBX" read little-endian
+#define EXT_VERSION 2
+#define MERGE_CHUNK 4096        // fewest states read or written at a time by a merge
+
+typedef struct ext_state
+{
+  uint32_t switch_check,block,damage,tick;   // sort order
+}ext_state;
+
+typedef struct ext_checkpoint
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t board_id;   // board_id() of the search the files belong to
+  int32_t depth;       // layers 0..depth are complete
+  int32_t reserved;
+  int64_t states;      // distinct states in them
+  uint64_t checksum;   // FNV-1a of every byte before it
+}ext_checkpoint;
+
+static_assert(sizeof(ext_checkpoint)==40,"ext_checkpoint layout changed, bump EXT_VERSION");
+
+/* A sorted state file read a chunk at a time */
+typedef struct state_reader
+{
+  FILE *f;
+  std::vector<ext_state> buf;
+  size_t pos,len;
+}state_reader;
+
+/* A state file written a chunk at a time */
+typedef struct state_writer
+{
+  FILE *f;
+  std::vector<ext_state> buf;
+  long count;
+  int ok;
+}state_writer;
+
+static bool state_before(const ext_state &a,const ext_state &b)
+{
+  if(a.switch_check!=b.switch_check)
+    return a.switch_check<b.switch_check;
+  if(a.block!=b.block)
+    return a.block<b.block;
+  if(a.damage!=b.damage)
+    return a.damage<b.damage;
+  return a.tick<b.tick;
+}
+
+static bool state_equal(const ext_state &a,const ext_state &b)
+{
+  return a.block==b.block && a.switch_check==b.switch_check && a.damage==b.damage && a.tick==b.tick;
+}
+
+static ext_state pack_state(const game_state *s)
+{
+  ext_state e;
+
+  e.switch_check=s->switch_check;
+  e.block=s->block;
+  e.damage=s->damage;
+  e.tick=s->tick;
+  return e;
+}
+
+static game_state unpack_state(const ext_state *e)
+{
+  game_state s;
+
+  s.block=e->block;
+  s.switch_check=e->switch_check;
+  s.damage=e->damage;
+  s.tick=e->tick;
+  s.no_of_moves=0;
+  return s;
+}
+
+static int open_reader(state_reader *r,const char *path,size_t chunk)
+{
+  struct stat st;
+
+  r->f=fopen(path,"rb");
+  r->pos=r->len=0;
+  if(!r->f)
+    return 0;
+  // no bigger than the file, as small layers are the common case
+  if(fstat(fileno(r->f),&st)==0 && (size_t)st.st_size/sizeof(ext_state)<chunk)
+    chunk=st.st_size/sizeof(ext_state)+1;
+  r->buf.resize(chunk);
+  return 1;
+}
+
+/* Next state without taking it, NULL at the end */
+static const ext_state *peek(state_reader *r)
+{
+  if(r->pos==r->len)
+  {
+    if(!r->f)
+      return NULL;
+    r->len=fread(&r->buf[0],sizeof(ext_state),r->buf.size(),r->f);
+    r->pos=0;
+    if(r->len==0)
+      return NULL;
+  }
+  return &r->buf[r->pos];
+}
+
+static void close_reader(state_reader *r)
+{
+  if(r->f)
+    fclose(r->f);
+  r->f=NULL;
+}
+
+static int open_writer(state_writer *w,const char *path,size_t chunk)
+{
+  w->f=fopen(path,"wb");
+  w->buf.clear();
+  w->buf.reserve(chunk);
+  w->count=0;
+  w->ok=(w->f!=NULL);
+  return w->ok;
+}
+
+static void flush_writer(state_writer *w)
+{
+  if(w->ok && !w->buf.empty())
+    w->ok=(fwrite(&w->buf[0],sizeof(ext_state),w->buf.size(),w->f)==w->buf.size());
+  w->buf.clear();
+}
+
+static void put(state_writer *w,const ext_state *s)
+{
+  w->buf.push_back(*s);
+  w->count++;
+  if(w->buf.size()==w->buf.capacity())
+    flush_writer(w);
+}
+
+/* Returns 0 if anything failed to write */
+static int close_writer(state_writer *w)
+{
+  flush_writer(w);
+  if(w->f && fclose(w->f)!=0)
+    w->ok=0;
+  w->f=NULL;
+  return w->ok;
+}
+
+static void file_name(char *out,size_t size,const char *dir,const char *name,int n)
+{
+  if(n<0)
+    snprintf(out,size,"%s/%s",dir,name);
+  else
+    snprintf(out,size,"%s/%s-%d",dir,name,n);
+}
+
+static uint64_t fnv(uint64_t h,const void *data,size_t n)
+{
+  const unsigned char *p=(const unsigned char *)data;
+  size_t i;
+
+  for(i=0;i<n;i++)
+    h=(h^p[i])*0x100000001b3ull;
+  return h;
+}
+
+/* Identifies the board and start a set of search files belongs to */
+static uint64_t board_id(const level_board *b,const game_state *start)
+{
+  uint64_t h=0xcbf29ce484222325ull;
+  ext_state s=pack_state(start);
+
+  h=fnv(h,&b->width,sizeof(b->width));
+  h=fnv(h,&b->height,sizeof(b->height));
+  h=fnv(h,&b->tiles[0],b->tiles.size());
+  h=fnv(h,&b->group[0],b->group.size());
+  h=fnv(h,&b->target[0],b->target.size()*sizeof(uint32_t));
+  h=fnv(h,&b->present[0],b->present.size()*sizeof(uint32_t));
+  return fnv(h,&s,sizeof(s));
+}
+
+static int write_checkpoint(const char *dir,uint64_t id,int depth,long states)
+{
+  ext_checkpoint c;
+  char path[4096],tmp[4096];
+
+  memset(&c,0,sizeof(c));
+  c.magic=EXT_MAGIC;
+  c.version=EXT_VERSION;
+  c.board_id=id;
+  c.depth=depth;
+  c.states=states;
+  c.checksum=fnv(0xcbf29ce484222325ull,&c,offsetof(ext_checkpoint,checksum));
+
+  file_name(path,sizeof(path),dir,"checkpoint",-1);
+  file_name(tmp,sizeof(tmp),dir,"checkpoint.tmp",-1);
+  FILE *f=fopen(tmp,"wb");
+  if(!f)
+    return 0;
+  int ok=(fwrite(&c,sizeof(c),1,f)==1);
+  ok&=(fclose(f)==0);
+  return ok && rename(tmp,path)==0;
+}
+
+/* Layers reached in an earlier run on the same board, 0 if none */
+static int read_checkpoint(const char *dir,uint64_t id,int *depth,long *states)
+{
+  ext_checkpoint c;
+  char path[4096];
+
+  file_name(path,sizeof(path),dir,"checkpoint",-1);
+  FILE *f=fopen(path,"rb");
+  if(!f)
+    return 0;
+  int ok=(fread(&c,sizeof(c),1,f)==1);
+  fclose(f);
+  if(!ok || c.magic!=EXT_MAGIC || c.version!=EXT_VERSION || c.board_id!=id ||
+      c.checksum!=fnv(0xcbf29ce484222325ull,&c,offsetof(ext_checkpoint,checksum)))
+    return 0;
+  *depth=c.depth;
+  *states=c.states;
+  return 1;
+}
+
+/* Sort and dedupe buf, then write it as run n */
+static int write_run(const char *dir,int n,std::vector<ext_state> &buf)
+{
+  char path[4096];
+  state_writer w;
+
+  std::sort(buf.begin(),buf.end(),state_before);
+  buf.erase(std::unique(buf.begin(),buf.end(),state_equal),buf.end());
+  file_name(path,sizeof(path),dir,"run",n);
+  if(!open_writer(&w,path,0))
+    return 0;
+  w.buf.swap(buf);
+  w.count=w.buf.size();
+  int ok=close_writer(&w);
+  buf.swap(w.buf);
+  buf.clear();
+  return ok;
+}
+
+/* Move the reader past states before s; returns 1 if it holds s */
+static int holds(state_reader *r,const ext_state *s)
+{
+  const ext_state *e;
+
+  while((e=peek(r)) && state_before(*e,*s))
+    r->pos++;
+  return e && state_equal(*e,*s);
+}
+
+typedef struct merge_head
+{
+  ext_state s;
+  int run;
+}merge_head;
+
+struct later_head
+{
+  bool operator()(const merge_head &a,const merge_head &b) const
+  {
+    return state_before(b.s,a.s);
+  }
+};
+
+/* Merge runs first..first+runs-1 into out, leaving out states the
+   excluded files hold. Returns the states written, -1 on an I/O error. */
+static long merge_runs(const char *dir,int first,int runs,const char **exclude,int excluded,const char *out,size_t chunk)
+{
+  std::vector<state_reader> run(runs);
+  std::vector<state_reader> old(excluded);
+  std::priority_queue<merge_head,std::vector<merge_head>,later_head> heads;
+  state_writer w;
+  char path[4096];
+  int i,ok=1;
+
+  for(i=0;i<runs;i++)
+  {
+    file_name(path,sizeof(path),dir,"run",first+i);
+    ok&=open_reader(&run[i],path,chunk);
+    const ext_state *e=peek(&run[i]);
+    if(e)
+    {
+      merge_head h={*e,i};
+      heads.push(h);
+      run[i].pos++;
+    }
+  }
+  // a layer or older file that isn't there yet holds nothing
+  for(i=0;i<excluded;i++)
+    open_reader(&old[i],exclude[i],chunk);
+  ok&=open_writer(&w,out,chunk);
+
+  ext_state last;
+  int any=0;
+  while(ok && !heads.empty())
+  {
+    merge_head h=heads.top();
+    heads.pop();
+    const ext_state *e=peek(&run[h.run]);
+    if(e)
+    {
+      merge_head next={*e,h.run};
+      heads.push(next);
+      run[h.run].pos++;
+    }
+
+    if(any && state_equal(last,h.s))
+      continue;
+    last=h.s;
+    any=1;
+    int seen=0;
+    for(i=0;i<excluded && !seen;i++)
+      seen=holds(&old[i],&h.s);
+    if(!seen)
+      put(&w,&h.s);
+  }
+
+  for(i=0;i<runs;i++)
+  {
+    close_reader(&run[i]);
+    file_name(path,sizeof(path),dir,"run",first+i);
+    unlink(path);
+  }
+  for(i=0;i<excluded;i++)
+    close_reader(&old[i]);
+  ok&=close_writer(&w);
+  return ok ? w.count : -1;
+}
+
+/* older = older + layer n, written beside it and renamed over it */
+static int merge_older(const char *dir,int n,size_t chunk)
+{
+  state_reader a,b;
+  state_writer w;
+  char older[4096],layer[4096],tmp[4096];
+  const ext_state *x,*y;
+
+  file_name(older,sizeof(older),dir,"older",-1);
+  file_name(layer,sizeof(layer),dir,"layer",n);
+  file_name(tmp,sizeof(tmp),dir,"older.tmp",-1);
+  open_reader(&a,older,chunk);
+  if(!open_reader(&b,layer,chunk) || !open_writer(&w,tmp,chunk))
+  {
+    close_reader(&a);
+    close_reader(&b);
+    return 0;
+  }
+  // a state in both is written once
+  for(;;)
+  {
+    x=peek(&a);
+    y=peek(&b);
+    if(!x && !y)
+      break;
+    if(x && (!y || !state_before(*y,*x)))
+    {
+      put(&w,x);
+      if(y && state_equal(*x,*y))
+        b.pos++;
+      a.pos++;
+    }
+    else
+    {
+      put(&w,y);
+      b.pos++;
+    }
+  }
+  close_reader(&a);
+  close_reader(&b);
+  return close_writer(&w) && rename(tmp,older)==0;
+}
+
+/* Roll back from target through layers depth..0, filling path[0..depth] */
+static int trace_path(const level_board *b,const char *dir,int depth,ext_state target,std::vector<unsigned char> &path,size_t chunk)
+{
+  char name[4096];
+  int k,dir_rolled;
+
+  for(k=depth;k>=0;k--)
+  {
+    state_reader r;
+    const ext_state *e;
+    int found=0;
+
+    file_name(name,sizeof(name),dir,"layer",k);
+    if(!open_reader(&r,name,chunk))
+      return 0;
+    for(;!found && (e=peek(&r));r.pos++)
+    {
+      for(dir_rolled=0;dir_rolled<NUM_DIRS;dir_rolled++)
+      {
+        game_state s=unpack_state(e);
+        if(step(b,&s,dir_rolled)!=MOVE_FALL && state_equal(pack_state(&s),target))
+        {
+          path[k]=dir_rolled;
+          target=*e;
+          found=1;
+          break;
+        }
+      }
+    }
+    close_reader(&r);
+    if(!found)
+      return 0;
+  }
+  return 1;
+}
+
+int solve_external(const level_board *b,const game_state *start,const char *dir,long memory,solve_result *r)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  size_t buffer=std::max(memory/(long)sizeof(ext_state),256L);
+  uint64_t id=board_id(b,start);
+  char path[4096],prev[4096],next[4096],older[4096];
+  int depth=0,i;
+  long states=1;
+
+  r->path.clear();
+  r->moves=-1;
+  r->gave_up=0;
+  r->states=0;
+
+  int reversible=1;
+  for(i=0;i<(int)b->flags.size();i++)
+    if(b->flags[i]&(TF_SWITCH|TF_BRIDGE|TF_SPECIAL))
+      reversible=0;
+
+  if(mkdir(dir,0755)!=0 && errno!=EEXIST)
+    return 0;
+  file_name(older,sizeof(older),dir,"older",-1);
+  if(!read_checkpoint(dir,id,&depth,&states))
+  {
+    state_writer w;
+    ext_state s=pack_state(start);
+
+    file_name(path,sizeof(path),dir,"layer",0);
+    unlink(older);
+    if(!open_writer(&w,path,1))
+      return 0;
+    put(&w,&s);
+    if(!close_writer(&w) || !write_checkpoint(dir,id,0,1))
+      return 0;
+  }
+
+  std::vector<ext_state> successors;
+  for(;;)
+  {
+    // every successor of layer depth, as sorted runs of one buffer each
+    state_reader layer;
+    const ext_state *e;
+    int runs=0,goal_dir=-1;
+    ext_state goal_from;
+
+    file_name(path,sizeof(path),dir,"layer",depth);
+    if(!open_reader(&layer,path,std::min(buffer,(size_t)1<<16)))
+      return 0;
+    successors.reserve(buffer);
+    for(;goal_dir<0 && (e=peek(&layer));layer.pos++)
+    {
+      int d;
+      for(d=0;d<NUM_DIRS;d++)
+      {
+        game_state s=unpack_state(e);
+        int outcome=step(b,&s,d);
+        if(outcome==MOVE_FALL)
+          continue;
+        if(outcome==MOVE_GOAL)
+        {
+          goal_from=*e;
+          goal_dir=d;
+          break;
+        }
+        successors.push_back(pack_state(&s));
+        if(successors.size()==buffer && !write_run(dir,runs++,successors))
+          return 0;
+      }
+    }
+    close_reader(&layer);
+
+    if(goal_dir>=0)
+    {
+      for(i=0;i<runs;i++)
+      {
+        file_name(path,sizeof(path),dir,"run",i);
+        unlink(path);
+      }
+      r->moves=depth+1;
+      r->path.resize(depth+1);
+      r->path[depth]=goal_dir;
+      if(depth>0 && !trace_path(b,dir,depth-1,goal_from,r->path,std::min(buffer,(size_t)1<<16)))
+        return 0;
+      break;
+    }
+    if(!successors.empty() && !write_run(dir,runs++,successors))
+      return 0;
+    // the buffer's memory goes to the merge's reads instead
+    std::vector<ext_state>().swap(successors);
+
+    // the merge has every run and the files it checks against open at
+    // once, each read a chunk at a time, and the chunks share the buffer
+    const char *exclude[3];
+    int excluded=0,first=0;
+    file_name(path,sizeof(path),dir,"layer",depth);
+    file_name(prev,sizeof(prev),dir,"layer",depth-1);
+    exclude[excluded++]=path;
+    if(depth>0)
+      exclude[excluded++]=prev;
+    if(!reversible)
+      exclude[excluded++]=older;
+
+    // too many runs for MERGE_CHUNK states apiece: merge them into fewer,
+    // longer runs first, up to fan-1 at a time
+    int fan=std::max((int)(buffer/MERGE_CHUNK),excluded+3);
+    while(runs-first+excluded+1>fan)
+    {
+      int n=std::min(fan-1,runs-first);
+      file_name(next,sizeof(next),dir,"run",runs);
+      if(merge_runs(dir,first,n,NULL,0,next,buffer/fan)<0)
+        return 0;
+      first+=n;
+      runs++;
+    }
+    size_t chunk=buffer/(runs-first+excluded+1);
+
+    file_name(next,sizeof(next),dir,"layer",depth+1);
+    long added=merge_runs(dir,first,runs-first,exclude,excluded,next,chunk);
+    if(added<0)
+      return 0;
+    if(added==0)
+      break;
+    if(!reversible && depth>0 && !merge_older(dir,depth-1,chunk))
+      return 0;
+    depth++;
+    states+=added;
+    if(!write_checkpoint(dir,id,depth,states))
+      return 0;
+  }
+
+  r->states=states;
+  r->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+  return 1;
+}
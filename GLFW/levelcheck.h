@@ -0,0 +1,85 @@
+#ifndef LEVELCHECK_H
+#define LEVELCHECK_H
+
+#include "board.h"
+
+/*
+ * Compile-time solving of fixed-size levels, so a level edited into being
+ * unsolvable or off its par stops the build instead of reaching players:
+ *
+ *   static_assert(par_of(board_1,START_X,START_Z)==26,"...");
+ *
+ * par_of() is a BFS over every padded cell, orientation and state of
+ * switch group 0, stepping between cells by Board's constant neighbour
+ * offsets. It uses the landing tests step() uses, on the level as
+ * load_board() sets it up: every switch and bridge in group 0 and every
+ * teleport sending the block back onto its own cell. Crumble and timed
+ * tiles need the damage bits and the tick and aren't covered.
+ */
+#define LEVEL_UNSOLVABLE -1
+#define LEVEL_UNCHECKED -2   // has crumble or timed tiles
+
+/* Fewest rolls from the block standing on (start_x,start_z) to standing
+   on the goal, or LEVEL_UNSOLVABLE / LEVEL_UNCHECKED */
+template<int W,int H>
+constexpr int par_of(const Board<W,H> &level,int start_x,int start_z)
+{
+  typedef Board<W,H> B;
+  constexpr int states=2*B::cells*3;   // switch group 0, padded cell, orientation
+  unsigned flags[B::cells]={};         // tile_rules[].flags, zero on the void border
+  int dist[states]={};                 // rolls+1 from the start, 0 while unreached
+  int queue[states]={};
+  int head=0,tail=0;
+  int x=0,z=0;
+
+  for(x=0;x<W;x++)
+  {
+    for(z=0;z<H;z++)
+    {
+      if(level.tile[x][z]==TILE_CRUMBLE || level.tile[x][z]==TILE_TIMED)
+        return LEVEL_UNCHECKED;
+      if(level.tile[x][z]<NUM_TILES)
+        flags[B::cell(x,z)]=tile_rules[level.tile[x][z]].flags;
+    }
+  }
+
+  // the border is as wide as a roll reaches past the edge, so no roll
+  // from a cell on the board looks outside flags[]
+  queue[tail++]=B::cell(start_x,start_z)*3+ORIENT_STANDING;
+  dist[queue[0]]=1;
+  while(head<tail)
+  {
+    int i=queue[head++];
+    int o=i%3;
+    int sw=i/(3*B::cells);
+    int c=i/3%B::cells;
+    int dir=0;
+
+    for(dir=0;dir<NUM_DIRS;dir++)
+    {
+      int o2=roll_orient[o][dir];
+      int c0=c+roll_dx[o][dir]*B::neighbour[DIR_RIGHT]+roll_dz[o][dir]*B::neighbour[DIR_UP];
+      int c1=c0+(o2==ORIENT_LYING_X)*B::neighbour[DIR_RIGHT]+(o2==ORIENT_LYING_Z)*B::neighbour[DIR_UP];
+      int standing=(o2==ORIENT_STANDING);
+      unsigned f0=flags[c0];
+      unsigned f1=flags[c1];
+      int held=(((f0&TF_SOLID)!=0) | (((f0&TF_BRIDGE)!=0) & sw)) &
+          (((f1&TF_SOLID)!=0) | (((f1&TF_BRIDGE)!=0) & sw));
+      int pressed=presses(f0,standing)|presses(f1,standing);
+
+      if(falls(f0,f1,standing,held,pressed))
+        continue;
+      if(standing && (f0&TF_GOAL))
+        return dist[i];
+      int j=((sw^pressed)*B::cells+c0)*3+o2;
+      if(!dist[j])
+      {
+        dist[j]=dist[i]+1;
+        queue[tail++]=j;
+      }
+    }
+  }
+  return LEVEL_UNSOLVABLE;
+}
+
+#endif
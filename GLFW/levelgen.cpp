@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "levels.h"
+#include "search.h"
+
+/*
+ * Level generator: makes levels out of normal, fragile, bridge and switch
+ * tiles and a goal, solves each, and keeps the ones whose par and
+ * branching are in the ranges asked for, written as a pack with the
+ * solver's data baked in as levelpack would.
+ *
+ * A candidate starts as the trail of a random walk of the block over an
+ * empty board, so there is a way from the start to the goal where the
+ * walk stopped upright. Then the walk's trail grows side paths, some of
+ * its tiles turn fragile, and a tile late in the walk may become a bridge
+ * worked by a switch earlier on. Most of that breaks the walk's own way
+ * through or opens a shorter one, which is what the solver is for.
+ *
+ * The branching is the effective branching factor b of the level: the b
+ * for which a tree of depth par, b children to a node, would have as many
+ * nodes as there are states reachable from the start. Near 1 the level is
+ * a corridor; the higher it is the more wrong turns there are to take.
+ *
+ * Level n of a pack comes from its own stream of random numbers, seeded
+ * from --seed and n, so a seed makes the same pack whatever the number of
+ * threads and whichever thread takes which level.
+ *
+ *   ./levelgen [--threads N] [--seed S] [--size W H] [--par MIN MAX]
+ *              [--branching MIN MAX] [--text] COUNT OUT
+ */
+#define GEN_TRIES 100000   // candidates for one level before giving up
+
+typedef struct gen_job
+{
+  int width,height;
+  int min_par,max_par;
+  float min_branching,max_branching;
+  uint64_t seed;
+  std::vector<level_def> *pack;
+  std::vector<char> failed;       // by level: no candidate was kept
+  std::atomic<int> next;          // the next level to make
+  std::atomic<int> stopping;      // a level failed, so the ranges are too narrow
+  std::atomic<long> tried;
+  std::atomic<long> states;
+}gen_job;
+
+static uint64_t split_mix(uint64_t x)
+{
+  x+=0x9e3779b97f4a7c15ull;
+  x=(x^(x>>30))*0xbf58476d1ce4e5b9ull;
+  x=(x^(x>>27))*0x94d049bb133111ebull;
+  return x^(x>>31);
+}
+
+static uint32_t next_random(uint64_t *x)
+{
+  *x^=*x<<13;
+  *x^=*x>>7;
+  *x^=*x<<17;
+  return (uint32_t)*x;
+}
+
+/* A random number from 0 to n-1 */
+static int pick(uint64_t *rng,int n)
+{
+  return (int)(((uint64_t)next_random(rng)*n)>>32);
+}
+
+/* The b for which 1+b+b^2+...+b^depth is states */
+static float branching(long states,int depth)
+{
+  double lo=1,hi=8;
+  int i,k;
+
+  if(depth<1 || states<=depth+1)
+    return 1;
+  for(i=0;i<40;i++)
+  {
+    double b=(lo+hi)/2,sum=1,power=1;
+    for(k=0;k<depth && sum<states;k++)
+    {
+      power*=b;
+      sum+=power;
+    }
+    if(sum<states)
+      lo=b;
+    else
+      hi=b;
+  }
+  return (float)((lo+hi)/2);
+}
+
+/* Mark the cells under the block, and note them in order in trail */
+static void cover(Board<Dynamic> *t,std::vector<int> *trail,uint32_t block)
+{
+  int x=block_x(block),z=block_z(block),o=block_orient(block);
+
+  if(t->at(x,z)==TILE_VOID)
+    trail->push_back(x*t->height+z);
+  t->set(x,z,TILE_NORMAL);
+  if(o==ORIENT_STANDING)
+    return;
+  x+=(o==ORIENT_LYING_X);
+  z+=(o==ORIENT_LYING_Z);
+  if(t->at(x,z)==TILE_VOID)
+    trail->push_back(x*t->height+z);
+  t->set(x,z,TILE_NORMAL);
+}
+
+/* A candidate for l: see the comment at the top */
+static void make_candidate(const gen_job *j,const level_board *open,uint64_t *rng,level_def *l)
+{
+  Board<Dynamic> &t=l->tiles;
+  std::vector<int> trail;   // x*height+z of the tiles in the order the walk laid them
+  game_state s;
+  int rolls=j->max_par+pick(rng,2*j->max_par+1);
+  int i,k,dir;
+
+  t=Board<Dynamic>(j->width,j->height);
+  l->start_x=pick(rng,j->width);
+  l->start_z=pick(rng,j->height);
+  l->start_orient=ORIENT_STANDING;
+  l->par=-1;
+  l->groups.clear();
+  l->teleports.clear();
+  l->timings.clear();
+  l->compiled=0;
+  l->solution.clear();
+  l->reachable=-1;
+  l->laid_out=0;
+  l->links.clear();
+
+  // the walk: rolls that stay on the board, until it has made enough and
+  // stands somewhere other than the start
+  place_block(&s,l->start_x,l->start_z);
+  cover(&t,&trail,s.block);
+  for(i=0;i<rolls || block_orient(s.block)!=ORIENT_STANDING ||
+      (block_x(s.block)==l->start_x && block_z(s.block)==l->start_z);i++)
+  {
+    game_state next;
+    int first=pick(rng,NUM_DIRS);
+    for(k=0;k<NUM_DIRS;k++)
+    {
+      next=s;
+      dir=(first+k)&(NUM_DIRS-1);
+      if(step(open,&next,dir)!=MOVE_FALL)
+        break;
+    }
+    s=next;
+    cover(&t,&trail,s.block);
+  }
+  int goal=block_x(s.block)*t.height+block_z(s.block);
+
+  // side paths off the trail, each a few tiles in a straight line
+  int paths=pick(rng,(int)trail.size()/4+1);
+  for(i=0;i<paths;i++)
+  {
+    int c=trail[pick(rng,trail.size())];
+    int x=c/t.height,z=c%t.height,length=1+pick(rng,3);
+    dir=pick(rng,NUM_DIRS);
+    for(k=0;k<length;k++)
+    {
+      x+=(dir==DIR_RIGHT)-(dir==DIR_LEFT);
+      z+=(dir==DIR_UP)-(dir==DIR_DOWN);
+      if(x<0 || z<0 || x>=t.width || z>=t.height)
+        break;
+      if(t.at(x,z)==TILE_VOID)
+        t.set(x,z,TILE_NORMAL);
+    }
+  }
+
+  // fragile tiles, never the start or the goal
+  for(i=0;i<t.width*t.height;i++)
+    if(t.tile[i]==TILE_NORMAL && i!=goal && i!=l->start_x*t.height+l->start_z && pick(rng,8)==0)
+      t.tile[i]=TILE_FRAGILE;
+
+  // a bridge in the second half of the trail and its switch in the first
+  int n=trail.size();
+  if(n>=8 && pick(rng,2))
+  {
+    int bridge=trail[n/2+pick(rng,n-n/2)];
+    int press=trail[1+pick(rng,n/2-1)];
+    if(bridge!=goal && press!=goal)
+    {
+      level_group g;
+      t.tile[bridge]=TILE_BRIDGE;
+      t.tile[press]=TILE_SWITCH;
+      g.group=1;
+      g.x=bridge/t.height;
+      g.z=bridge%t.height;
+      l->groups.push_back(g);
+      g.x=press/t.height;
+      g.z=press%t.height;
+      l->groups.push_back(g);
+    }
+  }
+  t.tile[goal]=TILE_GOAL;
+}
+
+/* Make level n: candidates from its stream until one is kept */
+static void make_level(gen_job *j,const level_board *open,int n)
+{
+  level_def *l=&(*j->pack)[n];
+  uint64_t rng=split_mix(j->seed^split_mix(n));
+  level_board board;
+  game_state start;
+  solve_result r;
+  int tries;
+
+  if(!rng)
+    rng=1;
+  for(tries=1;tries<=GEN_TRIES && !j->stopping;tries++)
+  {
+    make_candidate(j,open,&rng,l);
+    load_level(&board,l);
+    start_level(&start,l);
+    start.no_of_moves=0;
+    explore_bfs(&board,&start,&r);
+    j->states+=r.states;
+    if(r.moves<j->min_par || r.moves>j->max_par)
+      continue;
+    float b=branching(r.states,r.moves);
+    if(b<j->min_branching || b>j->max_branching)
+      continue;
+    l->par=r.moves;
+    l->solution=r.path;
+    l->reachable=r.states;
+    l->compiled=1;
+    lay_out_level(l);
+    j->tried+=tries;
+    return;
+  }
+  j->tried+=tries-1;
+  if(!j->stopping)
+    j->failed[n]=1;
+  j->stopping=1;
+}
+
+static void make_levels(gen_job *j)
+{
+  Board<Dynamic> all(j->width,j->height);
+  level_board open;   // the whole board normal, for the walks
+  int n;
+
+  all.tile.assign(all.tile.size(),TILE_NORMAL);
+  load_board(&open,all);
+  while(!j->stopping && (n=j->next++)<(int)j->pack->size())
+    make_level(j,&open,n);
+}
+
+int main(int argc,char **argv)
+{
+  std::vector<level_def> pack;
+  std::vector<std::thread> pool;
+  gen_job job;
+  int threads=std::thread::hardware_concurrency();
+  int text=0,first=1,count,i;
+
+  job.width=job.height=10;
+  job.min_par=12;
+  job.max_par=30;
+  job.min_branching=1.1f;
+  job.max_branching=1.5f;
+  job.seed=1;
+  for(;first<argc && !strncmp(argv[first],"--",2);first++)
+  {
+    if(first+1<argc && !strcmp(argv[first],"--threads"))
+      threads=atoi(argv[++first]);
+    else if(first+1<argc && !strcmp(argv[first],"--seed"))
+      job.seed=strtoull(argv[++first],NULL,0);
+    else if(first+2<argc && !strcmp(argv[first],"--size"))
+    {
+      job.width=atoi(argv[++first]);
+      job.height=atoi(argv[++first]);
+    }
+    else if(first+2<argc && !strcmp(argv[first],"--par"))
+    {
+      job.min_par=atoi(argv[++first]);
+      job.max_par=atoi(argv[++first]);
+    }
+    else if(first+2<argc && !strcmp(argv[first],"--branching"))
+    {
+      job.min_branching=atof(argv[++first]);
+      job.max_branching=atof(argv[++first]);
+    }
+    else if(!strcmp(argv[first],"--text"))
+      text=1;
+    else
+    {
+      printf("Unknown option %s\n",argv[first]);
+      return 2;
+    }
+  }
+  if(argc-first!=2)
+  {
+    printf("usage: levelgen [--threads N] [--seed S] [--size W H] [--par MIN MAX] [--branching MIN MAX] [--text] COUNT OUT\n");
+    return 2;
+  }
+  count=atoi(argv[first]);
+  if(count<1 || job.width<3 || job.height<3 || job.width*job.height>1<<16 ||
+      job.min_par<1 || job.max_par<job.min_par || job.max_branching<job.min_branching)
+  {
+    printf("Need at least one level, a board of 3x3 to 65536 tiles, and ranges from low to high\n");
+    return 2;
+  }
+  if(threads<1)
+    threads=1;
+
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  pack.resize(count);
+  job.pack=&pack;
+  job.failed.assign(count,0);
+  job.next=0;
+  job.stopping=0;
+  job.tried=0;
+  job.states=0;
+  for(i=1;i<threads;i++)
+    pool.push_back(std::thread(make_levels,&job));
+  make_levels(&job);
+  for(i=0;i<(int)pool.size();i++)
+    pool[i].join();
+  double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+
+  for(i=0;i<count;i++)
+    if(job.failed[i])
+      printf("level %d: nothing kept after %d candidates, try wider ranges\n",i+1,GEN_TRIES);
+  if(job.stopping)
+    return 1;
+
+  if(text)
+  {
+    if(!write_text_pack(argv[first+1],pack))
+    {
+      printf("Cannot write %s\n",argv[first+1]);
+      return 1;
+    }
+  }
+  else
+  {
+    int status=write_binary_pack(argv[first+1],pack);
+    if(status!=LEVEL_PACK_OK)
+    {
+      printf("%s: %s\n",argv[first+1],level_pack_error(status));
+      return 1;
+    }
+  }
+  printf("%d levels to %s from %ld candidates, %ld states in %.3f s on %d threads (%.0f levels/minute)\n",
+      count,argv[first+1],job.tried.load(),job.states.load(),seconds,threads,60*count/seconds);
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "levels.h"
+#include "search.h"
+
+/*
+ * Level compiler: reads a text (or binary) level pack and writes it as a
+ * binary pack the game maps instead of parsing, see levels.h, with what
+ * would otherwise be worked out as each level loads baked in: the par and
+ * an optimal solution, how many states are reachable from the start, the
+ * bounding box of the tiles and which bridges each switch works. Levels
+ * are compiled in parallel, --threads at once (the hardware's threads by
+ * default). A level that can't be cleared, or whose par in the source
+ * isn't its fewest rolls, stops the pack being written.
+ *
+ *   ./levelpack [--threads N] PACK OUT
+ */
+
+typedef struct compile_job
+{
+  std::vector<level_def> *pack;
+  std::vector<char> failed;       // by level: 1 unsolvable, 2 off its par
+  std::vector<int> solved_par;
+  std::atomic<int> next;          // the next level to take
+  std::atomic<long> states;
+}compile_job;
+
+static void compile_level(compile_job *j,int n)
+{
+  level_def *l=&(*j->pack)[n];
+  level_board board;
+  game_state start;
+  solve_result r;
+
+  load_level(&board,l);
+  start_level(&start,l);
+  start.no_of_moves=0;
+  explore_bfs(&board,&start,&r);
+  j->states+=r.states;
+  j->solved_par[n]=r.moves;
+  if(r.moves<0)
+  {
+    j->failed[n]=1;
+    return;
+  }
+  if(l->par>=0 && l->par!=r.moves)
+  {
+    j->failed[n]=2;
+    return;
+  }
+  l->par=r.moves;
+  l->solution=r.path;
+  l->reachable=r.states;
+  l->compiled=1;
+  l->laid_out=0;
+  lay_out_level(l);
+}
+
+static void compile_levels(compile_job *j)
+{
+  int n;
+
+  while((n=j->next++)<(int)j->pack->size())
+    compile_level(j,n);
+}
+
+int main(int argc,char **argv)
+{
+  std::vector<level_def> pack;
+  std::vector<std::thread> pool;
+  compile_job job;
+  int threads=std::thread::hardware_concurrency();
+  int first=1,i,ok=1;
+  size_t n;
+
+  for(;first<argc && !strncmp(argv[first],"--",2);first++)
+  {
+    if(first+1<argc && !strcmp(argv[first],"--threads"))
+      threads=atoi(argv[++first]);
+    else
+    {
+      printf("Unknown option %s\n",argv[first]);
+      return 2;
+    }
+  }
+  if(argc-first!=2)
+  {
+    printf("usage: levelpack [--threads N] PACK OUT\n");
+    return 2;
+  }
+  if(threads<1)
+    threads=1;
+  if(!read_level_pack(argv[first],&pack))
+    return 1;
+
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  job.pack=&pack;
+  job.failed.assign(pack.size(),0);
+  job.solved_par.assign(pack.size(),-1);
+  job.next=0;
+  job.states=0;
+  for(i=1;i<threads;i++)
+    pool.push_back(std::thread(compile_levels,&job));
+  compile_levels(&job);
+  for(i=0;i<(int)pool.size();i++)
+    pool[i].join();
+  double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+
+  for(n=0;n<pack.size();n++)
+  {
+    if(job.failed[n]==1)
+      printf("%s:%d: can't be cleared\n",argv[first],(int)n+1);
+    else if(job.failed[n]==2)
+      printf("%s:%d: the pack gives par %d, it takes %d\n",argv[first],(int)n+1,pack[n].par,job.solved_par[n]);
+    ok&=!job.failed[n];
+  }
+  if(!ok)
+    return 1;
+
+  int status=write_binary_pack(argv[first+1],pack);
+  if(status!=LEVEL_PACK_OK)
+  {
+    printf("%s: %s\n",argv[first+1],level_pack_error(status));
+    return 1;
+  }
+  printf("%d levels to %s, %ld states in %.3f s on %d threads (%.0f levels/s)\n",
+      (int)pack.size(),argv[first+1],job.states.load(),seconds,threads,pack.size()/seconds);
+  return 0;
+}
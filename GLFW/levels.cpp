@@ -0,0 +1,932 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "levels.h"
+#include "levelcheck.h"
+
+constexpr builtin_board board_1={{
+  //0 1 2 3 4 5 6 7 8 9
+  { 1,1,1,1,1,1,0,0,0,0}, //0
+  { 1,1,1,1,1,1,0,0,6,0},//1
+  { 1,1,0,0,1,1,0,0,1,0}, //2
+  { 1,1,0,0,1,1,1,1,1,0},//3
+  { 1,1,0,0,0,1,0,1,1,1}, //4
+  { 1,1,0,0,0,1,0,1,1,1}, //5
+  { 1,1,0,0,0,0,0,1,1,1} ,//6
+  { 1,1,0,0,0,0,0,1,1,0} ,//7
+  { 1,1,1,1,1,1,1,1,1,0} ,//8
+  { 1,1,1,1,1,1,1,1,1,0} //9
+}};
+
+constexpr builtin_board board_2={{
+  //0 1 2 3 4 5 6 7 8 9
+  {0,0,0,0,0,0,0,0,0,0}, //0
+  {0,1,1,1,1,1,1,0,6,0}, //1
+  {0,1,1,1,1,1,1,0,1,0}, //2
+  {1,1,1,0,0,3,0,1,1,1}, //3
+  {1,1,1,0,0,3,0,1,1,1}, //4
+  {1,1,1,0,0,1,0,1,1,1}, //5
+  {0,1,1,0,0,1,0,1,1,1}, //6
+  {0,1,1,0,0,4,0,1,1,1}, //7
+  {0,1,1,1,1,1,1,1,1,0}, //8
+  {0,1,1,1,1,1,1,1,1,0} //9
+}};
+
+
+constexpr builtin_board board_3={{
+  //0 1 2 3 4 5 6 7 8 9
+  {0,0,0,1,1,1,0,0,0,0},//0
+  {0,0,1,1,1,1,0,0,6,0},//1
+  {1,1,1,1,1,1,0,0,1,0},//2
+  {2,2,1,0,0,3,0,1,1,0},//3
+  {1,1,1,0,0,3,0,1,1,0},//4
+  {0,1,1,0,0,1,0,1,1,0},//5
+  {1,1,1,0,0,4,0,1,1,0},//6
+  {2,2,1,1,1,1,1,1,1,0},//7
+  {1,1,1,1,1,1,1,1,1,1},//8
+  {0,0,0,1,1,0,0,0,0,0}
+}};
+
+// an edit that breaks a level or changes its par stops the build here
+static_assert(par_of(board_1,START_X,START_Z)==builtin_pars[0],"level 1 is unsolvable or off its par");
+static_assert(par_of(board_2,START_X,START_Z)==builtin_pars[1],"level 2 is unsolvable or off its par");
+static_assert(par_of(board_3,START_X,START_Z)==builtin_pars[2],"level 3 is unsolvable or off its par");
+
+const builtin_board *builtin_level(int level)
+{
+  switch(level)
+  {
+    case 1: return &board_1;
+    case 2: return &board_2;
+    case 3: return &board_3;
+    default: return NULL;
+  }
+}
+
+void builtin_level_def(int level,level_def *l)
+{
+  const builtin_board *b=builtin_level(level);
+  int x,z;
+
+  l->tiles=Board<Dynamic>(builtin_board::width,builtin_board::height);
+  for(x=0;x<builtin_board::width;x++)
+    for(z=0;z<builtin_board::height;z++)
+      l->tiles.set(x,z,b->tile[x][z]);
+  l->start_x=START_X;
+  l->start_z=START_Z;
+  l->start_orient=ORIENT_STANDING;
+  l->par=builtin_pars[level-1];
+  l->groups.clear();
+  l->teleports.clear();
+  l->timings.clear();
+  l->compiled=0;
+  l->solution.clear();
+  l->reachable=-1;
+  l->laid_out=0;
+  l->links.clear();
+}
+
+void builtin_pack(std::vector<level_def> *pack)
+{
+  int level;
+
+  pack->resize(NUM_LEVELS);
+  for(level=1;level<=NUM_LEVELS;level++)
+    builtin_level_def(level,&(*pack)[level-1]);
+}
+
+/* The pack parser's place in the text */
+typedef struct pack_reader
+{
+  const char *p,*end;   // rest of the current line
+  int line;
+}pack_reader;
+
+static inline int blank(char c)
+{
+  return c==' ' || c=='\t' || c=='\r';
+}
+
+/* Skip blanks; returns 0 at the end of the line or a comment */
+static int more(pack_reader *r)
+{
+  while(r->p<r->end && blank(*r->p))
+    r->p++;
+  return r->p<r->end && *r->p!='#';
+}
+
+static int read_int(pack_reader *r,int *v)
+{
+  int sign=1,n=0,digits=0;
+
+  if(!more(r))
+    return 0;
+  if(*r->p=='-')
+  {
+    sign=-1;
+    r->p++;
+  }
+  while(r->p<r->end && *r->p>='0' && *r->p<='9' && n<100000000)
+  {
+    n=n*10+(*r->p++-'0');
+    digits++;
+  }
+  *v=sign*n;
+  return digits>0 && (r->p==r->end || blank(*r->p) || *r->p=='#');
+}
+
+/* The next word of the line, as a pointer and length */
+static int read_word(pack_reader *r,const char **w,int *n)
+{
+  if(!more(r))
+    return 0;
+  *w=r->p;
+  while(r->p<r->end && !blank(*r->p) && *r->p!='#')
+    r->p++;
+  *n=r->p-*w;
+  return 1;
+}
+
+static int is_word(const char *w,int n,const char *k)
+{
+  return (int)strlen(k)==n && !strncmp(w,k,n);
+}
+
+static int on_level(const level_def *l,int x,int z)
+{
+  return x>=0 && z>=0 && x<l->tiles.width && z<l->tiles.height;
+}
+
+/* Tile (x,z) of l, or of b when l's tiles were unpacked there instead */
+static int level_tile(const level_def *l,const level_board *b,int x,int z)
+{
+  return b ? tile_at(b,x,z) : l->tiles.at(x,z);
+}
+
+/* A tile line: append it as the next x of the level */
+static int read_tiles(pack_reader *r,level_def *l)
+{
+  int z=0;
+
+  for(;more(r);r->p++)
+  {
+    char c=*r->p;
+    if(c=='S')
+    {
+      l->start_x=l->tiles.width;
+      l->start_z=z;
+      l->start_orient=ORIENT_STANDING;
+      c='0'+TILE_NORMAL;
+    }
+    if(c<'0' || c>='0'+NUM_TILES)
+      return 0;
+    l->tiles.tile.push_back(c-'0');
+    z++;
+  }
+  if(l->tiles.width==0)
+    l->tiles.height=z;
+  l->tiles.width++;
+  return z==l->tiles.height;
+}
+
+/* A keyword line */
+static int read_setting(pack_reader *r,const char *w,int n,level_def *l)
+{
+  if(is_word(w,n,"start"))
+  {
+    const char *o;
+    int k;
+    if(!read_int(r,&l->start_x) || !read_int(r,&l->start_z))
+      return 0;
+    l->start_orient=ORIENT_STANDING;
+    if(read_word(r,&o,&k))
+    {
+      if(is_word(o,k,"x"))
+        l->start_orient=ORIENT_LYING_X;
+      else if(is_word(o,k,"z"))
+        l->start_orient=ORIENT_LYING_Z;
+      else if(!is_word(o,k,"standing"))
+        return 0;
+    }
+  }
+  else if(is_word(w,n,"par"))
+  {
+    if(!read_int(r,&l->par))
+      return 0;
+  }
+  else if(is_word(w,n,"group"))
+  {
+    level_group g;
+    if(!read_int(r,&g.x) || !read_int(r,&g.z) || !read_int(r,&g.group) || g.group<0 || g.group>=MAX_GROUPS)
+      return 0;
+    l->groups.push_back(g);
+  }
+  else if(is_word(w,n,"teleport"))
+  {
+    level_teleport t;
+    if(!read_int(r,&t.x) || !read_int(r,&t.z) || !read_int(r,&t.to_x) || !read_int(r,&t.to_z))
+      return 0;
+    l->teleports.push_back(t);
+  }
+  else if(is_word(w,n,"timed"))
+  {
+    level_timing t;
+    const char *pattern;
+    int i;
+    if(!read_int(r,&t.x) || !read_int(r,&t.z) || !read_word(r,&pattern,&t.period) || t.period>MAX_PERIOD)
+      return 0;
+    t.on=0;
+    for(i=0;i<t.period;i++)
+    {
+      if(pattern[i]!='0' && pattern[i]!='1')
+        return 0;
+      t.on|=(uint32_t)(pattern[i]=='1')<<i;
+    }
+    l->timings.push_back(t);
+  }
+  else
+    return 0;
+  return !more(r);
+}
+
+/* Once a level's lines are all read: does it fit, does it have a goal,
+   and is everything in it on a tile of the right kind? Its tiles are in
+   b if that isn't NULL. */
+static int check_level(const level_def *l,const level_board *b)
+{
+  const Board<Dynamic> &t=l->tiles;
+  size_t i;
+  int x,z,goals=0;
+
+  if(t.width==0 || t.height==0 || t.width>LEVEL_MAX_SIDE || t.height>LEVEL_MAX_SIDE)
+    return 0;
+  for(x=0;x<t.width;x++)
+    for(z=0;z<t.height;z++)
+      goals+=(level_tile(l,b,x,z)==TILE_GOAL);
+  if(goals==0)
+    return 0;
+  int x1=l->start_x+(l->start_orient==ORIENT_LYING_X);
+  int z1=l->start_z+(l->start_orient==ORIENT_LYING_Z);
+  if(!on_level(l,l->start_x,l->start_z) || !on_level(l,x1,z1))
+    return 0;
+  for(i=0;i<l->groups.size();i++)
+  {
+    const level_group *g=&l->groups[i];
+    if(!on_level(l,g->x,g->z) || (tile_rules[level_tile(l,b,g->x,g->z)].flags&(TF_SWITCH|TF_BRIDGE))==0)
+      return 0;
+  }
+  for(i=0;i<l->teleports.size();i++)
+  {
+    const level_teleport *p=&l->teleports[i];
+    if(!on_level(l,p->x,p->z) || level_tile(l,b,p->x,p->z)!=TILE_TELEPORT || !on_level(l,p->to_x,p->to_z))
+      return 0;
+  }
+  for(i=0;i<l->timings.size();i++)
+  {
+    const level_timing *p=&l->timings[i];
+    if(!on_level(l,p->x,p->z) || level_tile(l,b,p->x,p->z)!=TILE_TIMED)
+      return 0;
+  }
+  return 1;
+}
+
+static void new_level(std::vector<level_def> *pack)
+{
+  pack->push_back(level_def());
+  level_def *l=&pack->back();
+  l->start_x=START_X;
+  l->start_z=START_Z;
+  l->start_orient=ORIENT_STANDING;
+  l->par=-1;
+  l->reachable=-1;
+}
+
+static int read_text_pack(const char *path,std::vector<level_def> *pack);
+
+int parse_level_pack(const char *text,size_t size,std::vector<level_def> *pack,int *line)
+{
+  const char *end=text+size;
+  const char *p=text;
+  pack_reader r;
+  int level_line=1;   // where the level being read started
+  int tiles_done=0;   // its tile lines have ended
+
+  pack->clear();
+  r.line=0;
+  while(p<end)
+  {
+    const char *eol=(const char *)memchr(p,'\n',end-p);
+    if(!eol)
+      eol=end;
+    r.p=p;
+    r.end=eol;
+    r.line++;
+    p=eol+1;
+
+    const char *w;
+    int n;
+    if(!more(&r))
+      continue;
+    char c=*r.p;
+    if(c=='S' || (c>='0' && c<='9'))
+    {
+      if(pack->empty())
+      {
+        new_level(pack);
+        level_line=r.line;
+      }
+      if(tiles_done || !read_tiles(&r,&pack->back()))
+      {
+        *line=r.line;
+        return 0;
+      }
+      continue;
+    }
+    if(!pack->empty() && pack->back().tiles.width>0)
+      tiles_done=1;
+    read_word(&r,&w,&n);
+    if(is_word(w,n,"level"))
+    {
+      if(!pack->empty() && !check_level(&pack->back(),NULL))
+      {
+        *line=level_line;
+        return 0;
+      }
+      new_level(pack);
+      level_line=r.line;
+      tiles_done=0;
+      if(more(&r))
+      {
+        *line=r.line;
+        return 0;
+      }
+      continue;
+    }
+    if(pack->empty())
+    {
+      new_level(pack);
+      level_line=r.line;
+    }
+    if(!read_setting(&r,w,n,&pack->back()))
+    {
+      *line=r.line;
+      return 0;
+    }
+  }
+  if(pack->empty() || !check_level(&pack->back(),NULL))
+  {
+    *line=level_line;
+    return 0;
+  }
+  return 1;
+}
+
+int read_level_pack(const char *path,std::vector<level_def> *pack)
+{
+  level_pack_map m;
+  int status=map_level_pack(path,&m);
+  int n;
+
+  if(status==LEVEL_PACK_OK)
+  {
+    pack->resize(m.levels);
+    for(n=0;n<m.levels && status==LEVEL_PACK_OK;n++)
+      if(!read_mapped_level(&m,n,&(*pack)[n]))
+        status=LEVEL_PACK_DAMAGED;
+    unmap_level_pack(&m);
+  }
+  if(status!=LEVEL_PACK_BAD_MAGIC && status!=LEVEL_PACK_IO)
+  {
+    if(status!=LEVEL_PACK_OK)
+      printf("%s: %s\n",path,level_pack_error(status));
+    return status==LEVEL_PACK_OK;
+  }
+  return read_text_pack(path,pack);
+}
+
+/* A text pack, see parse_level_pack() */
+static int read_text_pack(const char *path,std::vector<level_def> *pack)
+{
+  FILE *f=fopen(path,"rb");
+  std::vector<char> text;
+  long size;
+  int line;
+
+  if(!f)
+  {
+    printf("Cannot read %s\n",path);
+    return 0;
+  }
+  fseek(f,0,SEEK_END);
+  size=ftell(f);
+  fseek(f,0,SEEK_SET);
+  text.resize(size>0 ? size : 1);
+  if(size<0 || fread(&text[0],1,size,f)!=(size_t)size)
+  {
+    fclose(f);
+    printf("Cannot read %s\n",path);
+    return 0;
+  }
+  fclose(f);
+  if(!parse_level_pack(&text[0],size,pack,&line))
+  {
+    printf("%s:%d: not a level pack line, or a level that doesn't fit together\n",path,line);
+    return 0;
+  }
+  return 1;
+}
+
+int write_text_pack(const char *path,const std::vector<level_def> &pack)
+{
+  static const char *orient_names[3]={ "standing","x","z" };
+  char tmp[4096];
+  size_t n,i;
+  int x,z;
+
+  if(snprintf(tmp,sizeof(tmp),"%s.tmp",path)>=(int)sizeof(tmp))
+    return 0;
+  FILE *f=fopen(tmp,"w");
+  if(!f)
+    return 0;
+  for(n=0;n<pack.size();n++)
+  {
+    const level_def *l=&pack[n];
+    const Board<Dynamic> &t=l->tiles;
+    // an S when the block starts upright on a normal tile, else a start line
+    int s_tile=l->start_orient==ORIENT_STANDING && t.at(l->start_x,l->start_z)==TILE_NORMAL;
+    fprintf(f,"level\n");
+    for(x=0;x<t.width;x++)
+    {
+      for(z=0;z<t.height;z++)
+        fputc((s_tile && x==l->start_x && z==l->start_z) ? 'S' : '0'+t.at(x,z),f);
+      fputc('\n',f);
+    }
+    if(!s_tile)
+      fprintf(f,"start %d %d %s\n",l->start_x,l->start_z,orient_names[l->start_orient]);
+    if(l->par>=0)
+      fprintf(f,"par %d\n",l->par);
+    for(i=0;i<l->groups.size();i++)
+      fprintf(f,"group %d %d %d\n",l->groups[i].x,l->groups[i].z,l->groups[i].group);
+    for(i=0;i<l->teleports.size();i++)
+      fprintf(f,"teleport %d %d %d %d\n",l->teleports[i].x,l->teleports[i].z,l->teleports[i].to_x,l->teleports[i].to_z);
+    for(i=0;i<l->timings.size();i++)
+    {
+      fprintf(f,"timed %d %d ",l->timings[i].x,l->timings[i].z);
+      for(x=0;x<l->timings[i].period;x++)
+        fputc('0'+((l->timings[i].on>>x)&1),f);
+      fputc('\n',f);
+    }
+  }
+  int ok=!ferror(f);
+  ok&=(fclose(f)==0);
+  if(!ok || rename(tmp,path)!=0)
+  {
+    unlink(tmp);
+    return 0;
+  }
+  return 1;
+}
+
+int read_levels(const char *arg,std::vector<level_def> *pack)
+{
+  char *end;
+  long n=strtol(arg,&end,10);
+
+  if(*end=='\0' && builtin_level(n))
+  {
+    pack->resize(1);
+    builtin_level_def(n,&(*pack)[0]);
+    return 1;
+  }
+  return read_level_pack(arg,pack);
+}
+
+/* Give the tiles of an indexed b l's groups, teleports and timings */
+static void set_up_level(level_board *b,const level_def *l)
+{
+  size_t i;
+
+  for(i=0;i<l->groups.size();i++)
+    set_group(b,l->groups[i].x,l->groups[i].z,l->groups[i].group);
+  for(i=0;i<l->teleports.size();i++)
+    set_teleport(b,l->teleports[i].x,l->teleports[i].z,l->teleports[i].to_x,l->teleports[i].to_z);
+  for(i=0;i<l->timings.size();i++)
+    set_timing(b,l->timings[i].x,l->timings[i].z,l->timings[i].period,l->timings[i].on);
+}
+
+void load_level(level_board *b,const level_def *l)
+{
+  load_board(b,l->tiles);
+  set_up_level(b,l);
+}
+
+/* Switch group of the switch or bridge at (x,z) */
+static int group_at(const level_def *l,int x,int z)
+{
+  size_t i;
+
+  for(i=0;i<l->groups.size();i++)
+    if(l->groups[i].x==x && l->groups[i].z==z)
+      return l->groups[i].group;
+  return 0;
+}
+
+void lay_out_level(level_def *l)
+{
+  const Board<Dynamic> &t=l->tiles;
+  std::vector<int> bridges;   // x*height+z
+  int x,z;
+  size_t i;
+
+  if(l->laid_out)
+    return;
+  l->min_x=t.width;
+  l->min_z=t.height;
+  l->max_x=-1;
+  l->max_z=-1;
+  for(x=0;x<t.width;x++)
+  {
+    for(z=0;z<t.height;z++)
+    {
+      if(t.at(x,z)==TILE_VOID)
+        continue;
+      if(x<l->min_x) l->min_x=x;
+      if(z<l->min_z) l->min_z=z;
+      if(x>l->max_x) l->max_x=x;
+      if(z>l->max_z) l->max_z=z;
+      if(tile_rules[t.at(x,z)].flags&TF_BRIDGE)
+        bridges.push_back(x*t.height+z);
+    }
+  }
+  // a level with no tiles at all is framed as one void tile
+  if(l->max_x<0)
+    l->min_x=l->min_z=l->max_x=l->max_z=0;
+
+  l->links.clear();
+  for(x=0;x<t.width;x++)
+  {
+    for(z=0;z<t.height;z++)
+    {
+      if(!(tile_rules[t.at(x,z)].flags&TF_SWITCH))
+        continue;
+      int g=group_at(l,x,z);
+      for(i=0;i<bridges.size();i++)
+      {
+        level_link k={ x,z,bridges[i]/t.height,bridges[i]%t.height };
+        if(group_at(l,k.bridge_x,k.bridge_z)==g)
+          l->links.push_back(k);
+      }
+    }
+  }
+  l->laid_out=1;
+}
+
+void start_level(game_state *s,const level_def *l)
+{
+  place_block(s,l->start_x,l->start_z);
+  s->block=pack_block(l->start_x,l->start_z,l->start_orient);
+}
+
+static uint64_t fnv(uint64_t h,const void *data,size_t size)
+{
+  const unsigned char *p=(const unsigned char *)data;
+  size_t i;
+
+  for(i=0;i<size;i++)
+    h=(h^p[i])*0x100000001b3ull;
+  return h;
+}
+
+uint64_t level_pack_id(const std::vector<level_def> &pack)
+{
+  // FNV-1a over the level count and everything in each level
+  uint64_t h=0xcbf29ce484222325ull;
+  size_t level,i;
+
+  i=pack.size();
+  h=fnv(h,&i,sizeof(i));
+  for(level=0;level<pack.size();level++)
+  {
+    const level_def *l=&pack[level];
+    int head[5]={ l->tiles.width,l->tiles.height,l->start_x,l->start_z,l->start_orient };
+    h=fnv(h,head,sizeof(head));
+    h=fnv(h,&l->tiles.tile[0],l->tiles.tile.size());
+    for(i=0;i<l->groups.size();i++)
+      h=fnv(h,&l->groups[i],sizeof(level_group));
+    for(i=0;i<l->teleports.size();i++)
+      h=fnv(h,&l->teleports[i],sizeof(level_teleport));
+    for(i=0;i<l->timings.size();i++)
+      h=fnv(h,&l->timings[i],sizeof(level_timing));
+  }
+  return h;
+}
+
+static_assert(sizeof(level_pack_header)==24,"level_pack_header layout changed, bump LEVEL_PACK_VERSION");
+static_assert(sizeof(packed_level)==64,"packed_level layout changed, bump LEVEL_PACK_VERSION");
+
+static const char *level_pack_errors[]={
+  "ok",
+  "cannot read file",
+  "not a binary level pack",
+  "unsupported level pack version",
+  "damaged level pack"
+};
+
+const char *level_pack_error(int status)
+{
+  return level_pack_errors[status];
+}
+
+static void put(std::vector<unsigned char> *out,const void *data,size_t size)
+{
+  const unsigned char *p=(const unsigned char *)data;
+  out->insert(out->end(),p,p+size);
+}
+
+/* Level l in the binary layout, appended to out */
+static void pack_level(std::vector<unsigned char> *out,const level_def *l)
+{
+  packed_level h;
+  size_t i;
+  int k;
+
+  memset(&h,0,sizeof(h));
+  h.width=l->tiles.width;
+  h.height=l->tiles.height;
+  h.start_x=l->start_x;
+  h.start_z=l->start_z;
+  h.start_orient=l->start_orient;
+  h.par=l->par;
+  h.groups=l->groups.size();
+  h.teleports=l->teleports.size();
+  h.timings=l->timings.size();
+  h.links=l->links.size();
+  h.solution=l->solution.size();
+  h.reachable=l->compiled ? l->reachable : -1;
+  h.min_x=l->min_x;
+  h.min_z=l->min_z;
+  h.max_x=l->max_x;
+  h.max_z=l->max_z;
+  h.compiled=(l->compiled!=0)|(l->laid_out!=0)<<1;
+  put(out,&h,sizeof(h));
+  for(i=0;i<l->groups.size();i++)
+  {
+    int32_t v[3]={ l->groups[i].x,l->groups[i].z,l->groups[i].group };
+    put(out,v,sizeof(v));
+  }
+  for(i=0;i<l->teleports.size();i++)
+  {
+    int32_t v[4]={ l->teleports[i].x,l->teleports[i].z,l->teleports[i].to_x,l->teleports[i].to_z };
+    put(out,v,sizeof(v));
+  }
+  for(i=0;i<l->timings.size();i++)
+  {
+    int32_t v[4]={ l->timings[i].x,l->timings[i].z,l->timings[i].period,(int32_t)l->timings[i].on };
+    put(out,v,sizeof(v));
+  }
+  for(i=0;i<l->links.size();i++)
+  {
+    int32_t v[4]={ l->links[i].x,l->links[i].z,l->links[i].bridge_x,l->links[i].bridge_z };
+    put(out,v,sizeof(v));
+  }
+  if(!l->solution.empty())
+    put(out,&l->solution[0],l->solution.size());
+  size_t tiles=out->size();
+  out->resize(tiles+(l->tiles.tile.size()+1)/2,0);
+  for(k=0;k<(int)l->tiles.tile.size();k++)
+    (*out)[tiles+k/2]|=l->tiles.tile[k]<<((k&1)*4);
+  out->resize((out->size()+7)&~(size_t)7,0);
+}
+
+int write_binary_pack(const char *path,const std::vector<level_def> &pack)
+{
+  std::vector<unsigned char> out;
+  level_pack_header h;
+  size_t n,index;
+  char tmp[4096];
+
+  memset(&h,0,sizeof(h));
+  h.magic=LEVEL_PACK_MAGIC;
+  h.version=LEVEL_PACK_VERSION;
+  h.pack_id=level_pack_id(pack);
+  h.levels=pack.size();
+  // the sizes and starts are narrowed to fit packed_level, and only come
+  // back whole from a level check_level() takes
+  for(n=0;n<pack.size();n++)
+    if(!check_level(&pack[n],NULL))
+      return LEVEL_PACK_DAMAGED;
+  put(&out,&h,sizeof(h));
+  index=out.size();
+  out.resize(index+(pack.size()+1)*sizeof(uint64_t));
+  for(n=0;n<=pack.size();n++)
+  {
+    uint64_t offset=out.size();
+    memcpy(&out[index+n*sizeof(uint64_t)],&offset,sizeof(offset));
+    if(n<pack.size())
+      pack_level(&out,&pack[n]);
+  }
+
+  // written beside the old pack and renamed over it, like save files
+  if(snprintf(tmp,sizeof(tmp),"%s.tmp",path)>=(int)sizeof(tmp))
+    return LEVEL_PACK_IO;
+  int fd=open(tmp,O_WRONLY|O_CREAT|O_TRUNC,0644);
+  if(fd<0)
+    return LEVEL_PACK_IO;
+  int ok=(write(fd,&out[0],out.size())==(ssize_t)out.size());
+  ok&=(close(fd)==0);
+  if(!ok || rename(tmp,path)!=0)
+  {
+    unlink(tmp);
+    return LEVEL_PACK_IO;
+  }
+  return LEVEL_PACK_OK;
+}
+
+int map_level_pack(const char *path,level_pack_map *m)
+{
+  struct stat st;
+  int fd=open(path,O_RDONLY);
+
+  m->base=NULL;
+  if(fd<0)
+    return LEVEL_PACK_IO;
+  if(fstat(fd,&st)!=0 || st.st_size<(off_t)sizeof(level_pack_header))
+  {
+    close(fd);
+    return LEVEL_PACK_IO;
+  }
+  void *map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+    return LEVEL_PACK_IO;
+  // levels are read one at a time wherever they are, so don't read ahead
+  madvise(map,st.st_size,MADV_RANDOM);
+
+  const level_pack_header *h=(const level_pack_header *)map;
+  size_t index=sizeof(level_pack_header);
+  int status=LEVEL_PACK_OK;
+  if(h->magic!=LEVEL_PACK_MAGIC)
+    status=LEVEL_PACK_BAD_MAGIC;
+  else if(h->version!=LEVEL_PACK_VERSION)
+    status=LEVEL_PACK_BAD_VERSION;
+  else if((uint64_t)h->levels+1>(st.st_size-index)/sizeof(uint64_t))
+    status=LEVEL_PACK_DAMAGED;
+  else
+  {
+    const uint64_t *offset=(const uint64_t *)((const unsigned char *)map+index);
+    if(offset[0]!=index+(h->levels+1)*sizeof(uint64_t) || offset[h->levels]!=(uint64_t)st.st_size)
+      status=LEVEL_PACK_DAMAGED;
+  }
+  if(status!=LEVEL_PACK_OK)
+  {
+    munmap(map,st.st_size);
+    return status;
+  }
+  m->base=(const unsigned char *)map;
+  m->size=st.st_size;
+  m->pack_id=h->pack_id;
+  m->levels=h->levels;
+  m->offset=(const uint64_t *)(m->base+index);
+  return LEVEL_PACK_OK;
+}
+
+void unmap_level_pack(level_pack_map *m)
+{
+  if(m->base)
+    munmap((void *)m->base,m->size);
+  m->base=NULL;
+}
+
+/* Read level n of a mapped pack into l, with its tiles into b instead if
+   that isn't NULL */
+static int read_packed_level(const level_pack_map *m,int n,level_def *l,level_board *b)
+{
+  if(n<0 || n>=m->levels)
+    return 0;
+  uint64_t begin=m->offset[n],end=m->offset[n+1];
+  if(begin>end || end>m->size || begin%8 || end-begin<sizeof(packed_level))
+    return 0;
+
+  const packed_level *h=(const packed_level *)(m->base+begin);
+  uint64_t tiles=(uint64_t)h->width*h->height;
+  uint64_t words=3*(uint64_t)h->groups+4*((uint64_t)h->teleports+h->timings+h->links);
+  if(sizeof(packed_level)+words*sizeof(int32_t)+h->solution+(tiles+1)/2>end-begin)
+    return 0;
+  const int32_t *v=(const int32_t *)(h+1);
+  const unsigned char *rolls=(const unsigned char *)(v+words);
+  const unsigned char *t=rolls+h->solution;
+  uint32_t i;
+  uint64_t k;
+
+  if(b)
+  {
+    int x,z;
+    l->tiles=Board<Dynamic>();
+    l->tiles.width=h->width;
+    l->tiles.height=h->height;
+    if(h->width>LEVEL_MAX_SIDE || h->height>LEVEL_MAX_SIDE)
+      return 0;
+    clear_board(b,h->width,h->height);
+    for(x=0,k=0;x<h->width;x++)
+    {
+      for(z=0;z<h->height;z++,k++)
+      {
+        int tile=(t[k/2]>>((k&1)*4))&15;
+        if(tile>=NUM_TILES)
+          return 0;
+        b->tiles[cell_index(b,x,z)]=tile;
+      }
+    }
+  }
+  else
+  {
+    l->tiles=Board<Dynamic>(h->width,h->height);
+    for(k=0;k<tiles;k++)
+    {
+      int tile=(t[k/2]>>((k&1)*4))&15;
+      if(tile>=NUM_TILES)
+        return 0;
+      l->tiles.tile[k]=tile;
+    }
+  }
+  l->start_x=h->start_x;
+  l->start_z=h->start_z;
+  l->start_orient=h->start_orient;
+  l->par=h->par;
+  l->groups.resize(h->groups);
+  for(i=0;i<h->groups;i++,v+=3)
+  {
+    l->groups[i].x=v[0];
+    l->groups[i].z=v[1];
+    l->groups[i].group=v[2];
+    if(v[2]<0 || v[2]>=MAX_GROUPS)
+      return 0;
+  }
+  l->teleports.resize(h->teleports);
+  for(i=0;i<h->teleports;i++,v+=4)
+  {
+    l->teleports[i].x=v[0];
+    l->teleports[i].z=v[1];
+    l->teleports[i].to_x=v[2];
+    l->teleports[i].to_z=v[3];
+  }
+  l->timings.resize(h->timings);
+  for(i=0;i<h->timings;i++,v+=4)
+  {
+    l->timings[i].x=v[0];
+    l->timings[i].z=v[1];
+    l->timings[i].period=v[2];
+    l->timings[i].on=v[3];
+    if(v[2]<1 || v[2]>MAX_PERIOD)
+      return 0;
+  }
+  l->links.resize(h->links);
+  for(i=0;i<h->links;i++,v+=4)
+  {
+    l->links[i].x=v[0];
+    l->links[i].z=v[1];
+    l->links[i].bridge_x=v[2];
+    l->links[i].bridge_z=v[3];
+    if(!on_level(l,v[0],v[1]) || !on_level(l,v[2],v[3]))
+      return 0;
+  }
+  l->solution.assign(rolls,rolls+h->solution);
+  for(i=0;i<h->solution;i++)
+    if(rolls[i]>=NUM_DIRS)
+      return 0;
+  l->compiled=h->compiled&1;
+  l->reachable=h->reachable;
+  l->laid_out=(h->compiled>>1)&1;
+  l->min_x=h->min_x;
+  l->min_z=h->min_z;
+  l->max_x=h->max_x;
+  l->max_z=h->max_z;
+  if(l->laid_out && (!on_level(l,l->min_x,l->min_z) || !on_level(l,l->max_x,l->max_z) ||
+      l->min_x>l->max_x || l->min_z>l->max_z))
+    return 0;
+  if(!(l->start_orient==ORIENT_STANDING || l->start_orient==ORIENT_LYING_X ||
+      l->start_orient==ORIENT_LYING_Z) || !check_level(l,b))
+    return 0;
+  if(b)
+  {
+    index_board(b);
+    set_up_level(b,l);
+  }
+  return 1;
+}
+
+int read_mapped_level(const level_pack_map *m,int n,level_def *l)
+{
+  return read_packed_level(m,n,l,NULL);
+}
+
+int load_mapped_level(level_board *b,const level_pack_map *m,int n,level_def *l)
+{
+  return read_packed_level(m,n,l,b);
+}
@@ -0,0 +1,220 @@
+#ifndef LEVELS_H
+#define LEVELS_H
+
+#include <stdint.h>
+
+#include "board.h"
+
+/* Built-in levels, indexed board_N.tile[x][z] like the game board */
+#define NUM_LEVELS 3
+
+typedef Board<10,10> builtin_board;
+
+// cell under the block at glm::vec3(0,0,0), where every level starts
+#define START_X 5
+#define START_Z 5
+
+// widest or longest level: a block rolled off its far edge still has to
+// fit pack_block()'s signed coordinates
+#define LEVEL_MAX_SIDE ((1<<(BLOCK_COORD_BITS-1))-BOARD_PAD)
+
+extern const builtin_board board_1;
+extern const builtin_board board_2;
+extern const builtin_board board_3;
+
+/* Fewest rolls that clear each built-in level, checked against the
+   levels while compiling */
+constexpr int builtin_pars[NUM_LEVELS]={ 26,15,9 };
+
+/* Built-in level 1..NUM_LEVELS, NULL for any other level */
+const builtin_board *builtin_level(int level);
+
+/*
+ * A level as the game plays it, built in or read from a level pack: tiles
+ * of any size, the cell and orientation the block starts in, the switch
+ * group of every switch and bridge not in group 0, where each teleport
+ * sends the block, the pattern of each timed tile, and the par.
+ */
+typedef struct level_group
+{
+  int x,z;
+  int group;
+}level_group;
+
+typedef struct level_teleport
+{
+  int x,z;
+  int to_x,to_z;
+}level_teleport;
+
+typedef struct level_timing
+{
+  int x,z;
+  int period;
+  uint32_t on;   // bit t set if the tile is there on tick t
+}level_timing;
+
+/* A switch and a bridge it extends and retracts */
+typedef struct level_link
+{
+  int x,z;
+  int bridge_x,bridge_z;
+}level_link;
+
+typedef struct level_def
+{
+  Board<Dynamic> tiles;
+  int start_x,start_z,start_orient;
+  int par;                                // -1 if not known
+  std::vector<level_group> groups;
+  std::vector<level_teleport> teleports;
+  std::vector<level_timing> timings;
+
+  // worked out ahead of time by the level compiler, levelpack, or else by
+  // lay_out_level() as the level loads
+  int compiled;                           // solution and reachable are filled in
+  std::vector<unsigned char> solution;    // DIR_* of an optimal solution
+  long reachable;                         // states reachable from the start
+  int laid_out;                           // the fields below are filled in
+  int min_x,min_z,max_x,max_z;            // bounding box of the non-void tiles
+  std::vector<level_link> links;          // every switch with every bridge it works
+}level_def;
+
+/* Built-in level 1..NUM_LEVELS as a level_def */
+void builtin_level_def(int level,level_def *l);
+
+/* Every built-in level, in order */
+void builtin_pack(std::vector<level_def> *pack);
+
+/*
+ * A level pack is a text file of levels, each a run of lines:
+ *
+ *   level                     starts the next level (optional for the first)
+ *   start X Z [standing|x|z]  the block's first cell, and lying along x or z
+ *   par N                     fewest rolls, shown when the level is cleared
+ *   group X Z G               the switch or bridge at (X,Z) is in group G
+ *   teleport X Z TX TZ        the teleport at (X,Z) sends the block to (TX,TZ)
+ *   timed X Z PATTERN         the timed tile at (X,Z) is there on tick t if
+ *                             character t of the 0/1 PATTERN is 1
+ *   0112...                   the tiles, one line per x with a digit per
+ *                             tile as in the arrays in levels.cpp; an 'S'
+ *                             is a normal tile the block starts on
+ *
+ * '#' starts a comment. A file of tile lines alone is a pack of one level
+ * starting on (START_X,START_Z) unless it has an 'S'. The parser makes one
+ * pass over the text with no allocation past the levels themselves.
+ */
+
+/* Parse a pack from text; returns 0 with *line set to the first bad line
+   if it is malformed, or to the first line of a level with no goal */
+int parse_level_pack(const char *text,size_t size,std::vector<level_def> *pack,int *line);
+
+/* Read a text or binary pack file; returns 0, saying why, if it can't be
+   read or parsed */
+int read_level_pack(const char *path,std::vector<level_def> *pack);
+
+/* Write pack to path as a text pack, replacing it only once complete;
+   returns 0 if it can't be written. What the level compiler works out
+   isn't written, only the par. */
+int write_text_pack(const char *path,const std::vector<level_def> &pack);
+
+/* The built-in level numbered by arg, or the levels of the pack file arg,
+   as the headless tools take them on the command line */
+int read_levels(const char *arg,std::vector<level_def> *pack);
+
+/* Set b up for level l, with its groups, teleports and timings */
+void load_level(level_board *b,const level_def *l);
+
+/* Put the block where level l starts it, as place_block() does */
+void start_level(game_state *s,const level_def *l);
+
+/* Work out the bounding box and switch links of l if it isn't compiled */
+void lay_out_level(level_def *l);
+
+/* Fingerprint of every level in a pack, so data saved against one pack
+   isn't used with another; what is worked out from the levels, the par
+   among it, doesn't count */
+uint64_t level_pack_id(const std::vector<level_def> &pack);
+
+/*
+ * Binary level packs hold the same levels ready to map: a header, an index
+ * of where each level starts, then the levels one after another. A level is
+ * a packed_level header, its groups (x,z,group), teleports (x,z,to_x,to_z),
+ * timings (x,z,period,on) and links (x,z,bridge_x,bridge_z) as int32s, its
+ * solution a byte a roll, and its tiles four bits each, tile (x,z) in the
+ * low nibble of byte (x*height+z)/2 when that is even, padded to eight
+ * bytes. Fields are in host byte order like save files.
+ *
+ * Opening one maps the file and checks only the header and the index
+ * bounds, so it takes the same time for any number of levels; reading a
+ * level touches just that level's pages and checks it as the text parser
+ * would. The tools unpack a level's nibbles into its level_def with
+ * read_mapped_level(); the game unpacks them once, straight into the
+ * padded level_board it plays and draws from, with load_mapped_level().
+ * Either way only the one level being played is unpacked, so it costs the
+ * same whatever the size of the pack.
+ */
+#define LEVEL_PACK_MAGIC 0x4b415042u   // "BPAK" read little-endian
+#define LEVEL_PACK_VERSION 2
+
+typedef struct level_pack_header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t pack_id;    // level_pack_id() of the levels
+  uint32_t levels;
+  uint32_t reserved;
+}level_pack_header;    // then levels+1 uint64_t offsets, the last the file size
+
+typedef struct packed_level
+{
+  uint16_t width,height;
+  int16_t start_x,start_z;
+  int64_t reachable;
+  int32_t start_orient;
+  int32_t par;
+  uint32_t groups,teleports,timings,links;
+  uint32_t solution;   // rolls
+  int32_t min_x,min_z,max_x,max_z;
+  uint32_t compiled;   // bit 0 compiled, bit 1 laid out
+}packed_level;
+
+typedef struct level_pack_map
+{
+  const unsigned char *base;   // NULL while nothing is mapped
+  size_t size;
+  uint64_t pack_id;
+  int levels;
+  const uint64_t *offset;      // into base, levels+1 of them
+}level_pack_map;
+
+/* Why a binary pack was rejected */
+enum {
+  LEVEL_PACK_OK=0,
+  LEVEL_PACK_IO,           // missing, unreadable or too short
+  LEVEL_PACK_BAD_MAGIC,    // not a binary pack, maybe a text one
+  LEVEL_PACK_BAD_VERSION,  // written by an incompatible build
+  LEVEL_PACK_DAMAGED       // the index or a level doesn't hold together
+};
+
+const char *level_pack_error(int status);
+
+/* Write pack to path as a binary pack, replacing it only once complete;
+   returns a LEVEL_PACK_* status, LEVEL_PACK_DAMAGED without writing if a
+   level wouldn't be read back, e.g. is over LEVEL_MAX_SIDE */
+int write_binary_pack(const char *path,const std::vector<level_def> &pack);
+
+/* Map a binary pack; returns a LEVEL_PACK_* status */
+int map_level_pack(const char *path,level_pack_map *m);
+
+void unmap_level_pack(level_pack_map *m);
+
+/* Read level n (from 0) of a mapped pack; returns 0 if it is damaged */
+int read_mapped_level(const level_pack_map *m,int n,level_def *l);
+
+/* Read level n of a mapped pack with its tiles unpacked into b, set up as
+   load_level() does, instead of into l, whose tiles are left with the
+   size of the level and none in them; returns 0 if it is damaged */
+int load_mapped_level(level_board *b,const level_pack_map *m,int n,level_def *l);
+
+#endif
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <chrono>
+#include <limits.h>
+#include <math.h>
+#include <thread>
+
+#include "mcts.h"
+
+/*
+ * A rollout scores between 0 and 1. One that reaches the goal scores over
+ * a half, more the fewer rolls it took from the root. One that doesn't
+ * scores under a half by the nearest it came, as astar_estimate() of the
+ * rolls left: a quarter for getting no nearer than the root, nothing for
+ * staying far away. Random rolls on a large board rarely find the goal,
+ * so the nearness is what steers the tree until they do. Either way the
+ * score is divided by one more than the times the bot already played from
+ * the states the rollout went through in the tree.
+ */
+#define MCTS_EXPLORE 0.7f   // UCT weight of trying rolls tried less
+
+static uint32_t next_random(uint64_t *x)
+{
+  *x^=*x<<13;
+  *x^=*x>>7;
+  *x^=*x<<17;
+  return (uint32_t)*x;
+}
+
+static float goal_score(const mcts_bot *m,int rolls)
+{
+  return 0.5f+0.5f*m->depth/(m->depth+rolls);
+}
+
+/* Random rolls from s that don't fall, at most m->depth of them */
+static float roll_out(const mcts_bot *m,mcts_tree *t,game_state s,int from_root,int root_estimate)
+{
+  int nearest=astar_estimate(&m->estimate,&s);
+  int k,i;
+
+  for(k=0;k<m->depth;k++)
+  {
+    // the rolls in a random order, the first that holds is taken
+    int first=next_random(&t->rng)&(NUM_DIRS-1);
+    int outcome=MOVE_FALL;
+    game_state next;
+    for(i=0;i<NUM_DIRS && outcome==MOVE_FALL;i++)
+    {
+      next=s;
+      outcome=step(m->board,&next,(first+i)&(NUM_DIRS-1));
+    }
+    if(outcome==MOVE_FALL)
+      break;
+    if(outcome==MOVE_GOAL)
+      return goal_score(m,from_root+k+1);
+    s=next;
+    int h=astar_estimate(&m->estimate,&s);
+    if(h<nearest)
+      nearest=h;
+  }
+  // in float, so the sum can't overflow however far the estimates are
+  return 0.5f*root_estimate/((float)root_estimate+nearest);
+}
+
+static int add_node(const mcts_bot *m,mcts_tree *t,const game_state *s,int parent,int goal)
+{
+  std::unordered_map<uint64_t,int>::const_iterator it=m->played.find(state_hash(s));
+  mcts_node n;
+  int dir;
+
+  n.s=*s;
+  for(dir=0;dir<NUM_DIRS;dir++)
+    n.child[dir]=MCTS_UNTRIED;
+  n.parent=parent;
+  n.visits=0;
+  n.score=0;
+  n.goal=goal;
+  n.repeats=(it==m->played.end()) ? 0 : std::min(it->second,255);
+  t->nodes.push_back(n);
+  return t->nodes.size()-1;
+}
+
+/* The child of n to walk down to by UCT, or -1 if every roll falls */
+static int best_child(const mcts_tree *t,int n)
+{
+  const mcts_node *p=&t->nodes[n];
+  float log_visits=logf((float)p->visits+1);
+  float best=-1;
+  int best_dir=-1,dir;
+
+  for(dir=0;dir<NUM_DIRS;dir++)
+  {
+    int c=p->child[dir];
+    if(c<0)
+      continue;
+    const mcts_node *q=&t->nodes[c];
+    float u=q->score/(q->visits+1e-6f)+MCTS_EXPLORE*sqrtf(log_visits/(q->visits+1e-6f));
+    if(u>best)
+    {
+      best=u;
+      best_dir=dir;
+    }
+  }
+  return best_dir;
+}
+
+/* One rollout: down the tree, one new roll, random rolls, and the score
+   back up to the root */
+static void rollout(const mcts_bot *m,mcts_tree *t,int root_estimate)
+{
+  int n=0,rolls=0,repeats=0,dir;
+  float score=-1;
+
+  for(;;)
+  {
+    if(t->nodes[n].goal)
+    {
+      score=goal_score(m,rolls);
+      break;
+    }
+
+    // a roll not tried yet, while the arena has room for it
+    for(dir=0;dir<NUM_DIRS && t->nodes[n].child[dir]!=MCTS_UNTRIED;dir++)
+      ;
+    if(dir<NUM_DIRS && (int)t->nodes.size()<m->capacity)
+    {
+      game_state s=t->nodes[n].s;
+      int outcome=step(m->board,&s,dir);
+      if(outcome==MOVE_FALL)
+      {
+        t->nodes[n].child[dir]=MCTS_FALLS;
+        continue;
+      }
+      int c=add_node(m,t,&s,n,outcome==MOVE_GOAL);
+      t->nodes[n].child[dir]=c;
+      n=c;
+      rolls++;
+      repeats+=t->nodes[n].repeats;
+      score=(outcome==MOVE_GOAL) ? goal_score(m,rolls) : roll_out(m,t,s,rolls,root_estimate);
+      break;
+    }
+
+    dir=best_child(t,n);
+    if(dir<0)
+    {
+      // every roll from here falls, or the arena is full
+      score=(t->nodes[n].child[0]==MCTS_FALLS && t->nodes[n].child[1]==MCTS_FALLS &&
+          t->nodes[n].child[2]==MCTS_FALLS && t->nodes[n].child[3]==MCTS_FALLS) ?
+          0 : roll_out(m,t,t->nodes[n].s,rolls,root_estimate);
+      break;
+    }
+    n=t->nodes[n].child[dir];
+    rolls++;
+    repeats+=t->nodes[n].repeats;
+  }
+
+  score/=1+repeats;
+  for(;n>=0;n=t->nodes[n].parent)
+  {
+    t->nodes[n].visits++;
+    t->nodes[n].score+=score;
+  }
+  t->rollouts++;
+}
+
+static void grow_tree(const mcts_bot *m,mcts_tree *t,const game_state *s,long rollouts)
+{
+  int root_estimate=astar_estimate(&m->estimate,s);
+  long i;
+
+  if(root_estimate<1)
+    root_estimate=1;
+  t->nodes.clear();
+  t->rollouts=0;
+  add_node(m,t,s,-1,0);
+  for(i=0;i<rollouts;i++)
+    rollout(m,t,root_estimate);
+}
+
+void mcts_init(mcts_bot *m,const level_board *b,int threads,int capacity,int depth)
+{
+  game_state none;
+  int i;
+
+  if(threads<1)
+    threads=1;
+  m->board=b;
+  m->threads=threads;
+  m->capacity=(capacity<1) ? 1 : capacity;
+  m->depth=(depth<1) ? 1 : depth;
+  place_block(&none,0,0);
+  astar_start(&m->estimate,b,&none,0);
+  m->trees.resize(threads);
+  for(i=0;i<threads;i++)
+  {
+    m->trees[i].nodes.clear();
+    m->trees[i].nodes.reserve(m->capacity);
+    m->trees[i].rng=0x9e3779b97f4a7c15ull*(i+1);
+  }
+  m->played.clear();
+  m->chosen=MCTS_IDLE;
+  m->rollouts=0;
+  m->seconds=0;
+  m->rollouts_per_second=0;
+}
+
+int mcts_choose(mcts_bot *m,const game_state *s,long rollouts)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  long share=(rollouts+m->threads-1)/m->threads;
+  long visits[NUM_DIRS]={0};
+  int i,dir,best=-1;
+
+  // no need to search for a roll onto the goal
+  for(dir=0;dir<NUM_DIRS;dir++)
+  {
+    game_state next=*s;
+    if(step(m->board,&next,dir)==MOVE_GOAL)
+      return dir;
+  }
+
+  // with no goal about the rollouts have nothing to score by
+  if(astar_estimate(&m->estimate,s)>=INT_MAX/2)
+    return -1;
+
+  m->played[state_hash(s)]++;
+  if(share<1)
+    share=1;
+  for(i=1;i<m->threads;i++)
+    pool.push_back(std::thread(grow_tree,m,&m->trees[i],s,share));
+  grow_tree(m,&m->trees[0],s,share);
+  for(i=0;i<(int)pool.size();i++)
+    pool[i].join();
+
+  m->rollouts=0;
+  for(i=0;i<m->threads;i++)
+  {
+    const mcts_tree *t=&m->trees[i];
+    m->rollouts+=t->rollouts;
+    for(dir=0;dir<NUM_DIRS;dir++)
+      if(t->nodes[0].child[dir]>=0)
+        visits[dir]+=t->nodes[t->nodes[0].child[dir]].visits;
+  }
+  for(dir=0;dir<NUM_DIRS;dir++)
+    if(visits[dir]>0 && (best<0 || visits[dir]>visits[best]))
+      best=dir;
+
+  m->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+  m->rollouts_per_second=(m->seconds>0) ? m->rollouts/m->seconds : 0;
+  return best;
+}
+
+static void think(mcts_bot *m,game_state s,long rollouts)
+{
+  m->chosen=mcts_choose(m,&s,rollouts);
+}
+
+void mcts_start(mcts_bot *m,const game_state *s,long rollouts)
+{
+  mcts_stop(m);
+  m->chosen=MCTS_THINKING;
+  m->thinker=std::thread(think,m,*s,rollouts);
+}
+
+int mcts_poll(mcts_bot *m)
+{
+  int dir=m->chosen;
+
+  if(dir==MCTS_THINKING || dir==MCTS_IDLE)
+    return dir;
+  m->thinker.join();
+  m->chosen=MCTS_IDLE;
+  return dir;
+}
+
+void mcts_stop(mcts_bot *m)
+{
+  if(m->thinker.joinable())
+    m->thinker.join();
+  m->chosen=MCTS_IDLE;
+}
@@ -0,0 +1,93 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+#include "search.h"
+
+/*
+ * Monte Carlo tree search player, for boards too big to solve outright.
+ * Each decision grows a tree of rolls from the block's state. A rollout
+ * walks down the tree by UCT, adds one new roll, then makes random rolls
+ * that don't fall until it reaches the goal or runs out of rolls, and is
+ * scored by how close to the goal it got (see mcts.cpp). The roll played
+ * is the one tried most at the root. The bot remembers the states it has
+ * played from, and a rollout through one of them scores less, so it
+ * doesn't go round in circles near the goal when the way there is a
+ * detour.
+ *
+ * It is root-parallel: every thread grows a tree of its own from the same
+ * state with its own random numbers and their root counts are added up,
+ * so the threads share nothing while they run. Each tree's nodes come
+ * from an arena reserved by mcts_init() and emptied for each decision; a
+ * tree whose arena is full stops growing and carries on with rollouts
+ * from its leaves.
+ *
+ * The game starts each decision with mcts_start() on a thread of its own,
+ * which grows the first tree and starts the others, and picks up the roll
+ * with mcts_poll() on a later frame, so it keeps drawing meanwhile.
+ */
+#define MCTS_UNTRIED -1   // mcts_node.child of a roll not tried yet
+#define MCTS_FALLS -2     // and of one that falls
+
+#define MCTS_THINKING -3  // mcts_poll() while a decision runs
+#define MCTS_IDLE -4      // and with none started since the last handed over
+
+typedef struct mcts_node
+{
+  game_state s;
+  int32_t child[NUM_DIRS];   // node index, or MCTS_UNTRIED / MCTS_FALLS
+  int32_t parent;
+  uint32_t visits;
+  float score;               // sum of the rollout scores through here
+  unsigned char goal;        // s stands on the goal
+  unsigned char repeats;     // times the bot played from s, at most 255
+}mcts_node;
+
+typedef struct mcts_tree
+{
+  std::vector<mcts_node> nodes;   // reserved up front, never past capacity
+  uint64_t rng;
+  long rollouts;
+}mcts_tree;
+
+typedef struct mcts_bot
+{
+  const level_board *board;
+  int threads;
+  int capacity;            // nodes in each tree
+  int depth;               // random rolls at most in a rollout
+  astar_search estimate;   // only for astar_estimate(), holds no nodes
+  std::vector<mcts_tree> trees;
+  std::unordered_map<uint64_t,int> played;   // times the bot played from each state_hash()
+  long rollouts;           // in the last decision, over every thread
+  double seconds;          // that it took
+  double rollouts_per_second;
+  std::atomic<int> chosen;   // the roll mcts_start() chose, or MCTS_THINKING / MCTS_IDLE
+  std::thread thinker;
+}mcts_bot;
+
+/* Get ready to play board b with threads trees of capacity nodes each and
+   rollouts of at most depth random rolls, remembering no states played */
+void mcts_init(mcts_bot *m,const level_board *b,int threads,int capacity,int depth);
+
+/* The DIR_* to roll from s after a budget of rollouts shared by the
+   threads, or -1 if every roll falls or no goal can be reached; s counts
+   as played from */
+int mcts_choose(mcts_bot *m,const game_state *s,long rollouts);
+
+/* mcts_choose() on a background thread, after waiting for any decision
+   still running; m mustn't be touched otherwise until mcts_poll() hands
+   the roll over or mcts_stop() returns */
+void mcts_start(mcts_bot *m,const game_state *s,long rollouts);
+
+/* The roll of the decision mcts_start() began, once it is done, handed
+   over only once; MCTS_THINKING until then, MCTS_IDLE with none begun */
+int mcts_poll(mcts_bot *m);
+
+/* Wait for a decision still running, dropping its roll */
+void mcts_stop(mcts_bot *m);
+
+#endif
@@ -0,0 +1,333 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "search.h"
+
+/*
+ * Breadth-first search with a layer's expansion spread over threads.
+ *
+ * Visited states are a lock-free open-addressed set of 64-bit keys, the
+ * switch bits over the block word, claimed with one compare-and-swap.
+ * Each layer is cut into chunks of states and every thread starts with an
+ * even share of the chunks as a range packed into one atomic word: the
+ * owner takes chunks from the front and an idle thread steals the back
+ * half, both with a compare-and-swap on that word. New states go to the
+ * finding thread's own list, and the lists become the next layer once
+ * every thread is done. The table only grows between layers, sized so a
+ * layer can't fill it.
+ */
+
+#define EMPTY_KEY (~0ull)   // no state packs to all ones: orientation 3 is unused
+#define CHUNK 256           // states taken at a time
+
+typedef struct layer_entry
+{
+  uint64_t key;
+  int32_t parent;        // index in the previous layer
+  unsigned char dir;     // roll that led here
+}layer_entry;
+
+/* One thread's chunk range, on its own cache line */
+typedef struct alignas(64) chunk_range
+{
+  std::atomic<uint64_t> span;   // first chunk <<32 | end chunk
+}chunk_range;
+
+typedef struct par_search
+{
+  const level_board *board;
+  int threads;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> slot;
+  size_t mask;
+  long count;
+
+  std::vector<std::vector<layer_entry> > layers;
+  std::vector<std::vector<layer_entry> > local;   // each thread's finds this layer
+  std::unique_ptr<chunk_range[]> range;
+  std::atomic<int64_t> goal;                     // thread<<32 | index in local, -1 while none
+
+  // the pool runs one layer per generation
+  std::mutex lock;
+  std::condition_variable wake,done;
+  int generation;
+  int running;
+  int quit;
+}par_search;
+
+static inline uint64_t key_of(const game_state *s)
+{
+  return (uint64_t)s->switch_check<<32 | s->block;
+}
+
+static inline uint64_t key_hash(uint64_t k)
+{
+  k=(k^(k>>31))*0xbf58476d1ce4e5b9ull;
+  return k^(k>>29);
+}
+
+/* Add key; returns 1 if this call added it */
+static int claim(par_search *ps,uint64_t key)
+{
+  size_t i=key_hash(key)&ps->mask;
+
+  for(;;)
+  {
+    uint64_t cur=ps->slot[i].load(std::memory_order_relaxed);
+    if(cur==key)
+      return 0;
+    if(cur==EMPTY_KEY)
+    {
+      if(ps->slot[i].compare_exchange_strong(cur,key,std::memory_order_relaxed))
+        return 1;
+      if(cur==key)
+        return 0;
+      continue;
+    }
+    i=(i+1)&ps->mask;
+  }
+}
+
+/* Make room for at least n keys at under half load, between layers only */
+static void reserve_keys(par_search *ps,long n)
+{
+  size_t size=ps->mask+1;
+  size_t i;
+
+  if(ps->slot && (long)size>=2*n)
+    return;
+  while((long)size<2*n)
+    size*=2;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> old;
+  size_t old_size=ps->slot ? ps->mask+1 : 0;
+  old.swap(ps->slot);
+  ps->slot.reset(new std::atomic<uint64_t>[size]);
+  ps->mask=size-1;
+  for(i=0;i<size;i++)
+    ps->slot[i].store(EMPTY_KEY,std::memory_order_relaxed);
+  for(i=0;i<old_size;i++)
+  {
+    uint64_t key=old[i].load(std::memory_order_relaxed);
+    if(key!=EMPTY_KEY)
+      claim(ps,key);
+  }
+}
+
+/* Next chunk from thread t's own range, or -1 */
+static int take_chunk(chunk_range *r)
+{
+  uint64_t span=r->span.load(std::memory_order_relaxed);
+
+  for(;;)
+  {
+    uint32_t first=span>>32,end=(uint32_t)span;
+    if(first>=end)
+      return -1;
+    if(r->span.compare_exchange_weak(span,(uint64_t)(first+1)<<32 | end,std::memory_order_relaxed))
+      return first;
+  }
+}
+
+/* Move the back half of victim's range to thief's; 0 if there was nothing */
+static int steal_chunks(chunk_range *victim,chunk_range *thief)
+{
+  uint64_t span=victim->span.load(std::memory_order_relaxed);
+
+  for(;;)
+  {
+    uint32_t first=span>>32,end=(uint32_t)span;
+    if(first>=end)
+      return 0;
+    uint32_t half=(end-first+1)/2;
+    if(victim->span.compare_exchange_weak(span,(uint64_t)first<<32 | (end-half),std::memory_order_relaxed))
+    {
+      thief->span.store((uint64_t)(end-half)<<32 | end,std::memory_order_relaxed);
+      return 1;
+    }
+  }
+}
+
+static void expand_chunk(par_search *ps,int t,int chunk)
+{
+  const std::vector<layer_entry> &layer=ps->layers.back();
+  std::vector<layer_entry> &found=ps->local[t];
+  int end=std::min((int)layer.size(),(chunk+1)*CHUNK);
+  int i,dir;
+
+  for(i=chunk*CHUNK;i<end;i++)
+  {
+    for(dir=0;dir<NUM_DIRS;dir++)
+    {
+      game_state s;
+      s.block=(uint32_t)layer[i].key;
+      s.switch_check=layer[i].key>>32;
+      s.damage=0;
+      s.tick=0;
+      s.no_of_moves=0;
+
+      int outcome=step(ps->board,&s,dir);
+      if(outcome==MOVE_FALL || !claim(ps,key_of(&s)))
+        continue;
+      layer_entry e;
+      e.key=key_of(&s);
+      e.parent=i;
+      e.dir=dir;
+      found.push_back(e);
+      if(outcome==MOVE_GOAL)
+      {
+        int64_t none=-1;
+        ps->goal.compare_exchange_strong(none,(int64_t)t<<32 | (found.size()-1));
+      }
+    }
+  }
+}
+
+static void expand_layer(par_search *ps,int t)
+{
+  int chunk,v;
+
+  for(;;)
+  {
+    while((chunk=take_chunk(&ps->range[t]))>=0)
+      expand_chunk(ps,t,chunk);
+    // out of work: steal from the others in turn, stop once all are empty
+    for(v=1;v<ps->threads;v++)
+      if(steal_chunks(&ps->range[(t+v)%ps->threads],&ps->range[t]))
+        break;
+    if(v==ps->threads)
+      return;
+  }
+}
+
+static void worker(par_search *ps,int t)
+{
+  int seen=0;
+
+  for(;;)
+  {
+    {
+      std::unique_lock<std::mutex> l(ps->lock);
+      while(ps->generation==seen && !ps->quit)
+        ps->wake.wait(l);
+      if(ps->quit)
+        return;
+      seen=ps->generation;
+    }
+    expand_layer(ps,t);
+    std::lock_guard<std::mutex> l(ps->lock);
+    if(--ps->running==0)
+      ps->done.notify_one();
+  }
+}
+
+void solve_parallel(const level_board *b,const game_state *start,int threads,solve_result *r)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  par_search ps;
+  int t;
+
+  r->path.clear();
+  r->moves=-1;
+  r->gave_up=0;
+  r->states=0;
+
+  // crumble damage and the tick don't fit the 64-bit key
+  if(b->crumble_count || b->period>1)
+  {
+    solve_bfs(b,start,r);
+    return;
+  }
+
+  if(threads<1)
+    threads=1;
+  ps.board=b;
+  ps.threads=threads;
+  ps.mask=0;
+  ps.count=1;
+  ps.local.resize(threads);
+  ps.range.reset(new chunk_range[threads]);
+  ps.goal.store(-1);
+  ps.generation=0;
+  ps.running=0;
+  ps.quit=0;
+
+  layer_entry e;
+  game_state s=*start;
+  s.damage=0;
+  s.tick=0;
+  e.key=key_of(&s);
+  e.parent=-1;
+  e.dir=0;
+  ps.layers.push_back(std::vector<layer_entry>(1,e));
+  reserve_keys(&ps,1024);
+  claim(&ps,e.key);
+
+  std::vector<std::thread> pool;
+  for(t=0;t<threads;t++)
+    pool.push_back(std::thread(worker,&ps,t));
+
+  while(!ps.layers.back().empty() && ps.goal.load()<0)
+  {
+    long n=ps.layers.back().size();
+    int chunks=(n+CHUNK-1)/CHUNK;
+
+    reserve_keys(&ps,ps.count+NUM_DIRS*n);
+    for(t=0;t<threads;t++)
+    {
+      ps.local[t].clear();
+      ps.range[t].span.store((uint64_t)(chunks*(long)t/threads)<<32 | (uint32_t)(chunks*(long)(t+1)/threads));
+    }
+
+    {
+      std::unique_lock<std::mutex> l(ps.lock);
+      ps.running=threads;
+      ps.generation++;
+      ps.wake.notify_all();
+      while(ps.running)
+        ps.done.wait(l);
+    }
+
+    // the threads' finds, in thread order, are the next layer
+    std::vector<layer_entry> next;
+    int64_t goal=ps.goal.load();
+    long goal_index=-1;
+    for(t=0;t<threads;t++)
+    {
+      if(goal>=0 && (goal>>32)==t)
+        goal_index=next.size()+(uint32_t)goal;
+      next.insert(next.end(),ps.local[t].begin(),ps.local[t].end());
+    }
+    ps.count+=next.size();
+    ps.layers.push_back(std::vector<layer_entry>());
+    ps.layers.back().swap(next);
+
+    if(goal_index>=0)
+    {
+      int depth=ps.layers.size()-1;
+      long i=goal_index;
+      r->moves=depth;
+      r->path.resize(depth);
+      for(;depth>0;depth--)
+      {
+        r->path[depth-1]=ps.layers[depth][i].dir;
+        i=ps.layers[depth][i].parent;
+      }
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> l(ps.lock);
+    ps.quit=1;
+    ps.wake.notify_all();
+  }
+  for(t=0;t<threads;t++)
+    pool[t].join();
+
+  r->states=ps.count;
+  r->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
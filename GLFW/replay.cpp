@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "rules.h"
+#include "levels.h"
+#include "zobrist.h"
+#include "undo.h"
+
+/*
+ * Headless replay check: plays a hash stream recorded with
+ * `sample2D --record FILE` back through step() and reports the first move
+ * whose state hash differs from the recording. With a second stream it
+ * instead compares the two recordings directly. A session played with
+ * `sample2D --levels PACK` is replayed against the same pack.
+ *
+ *   ./replay [--levels PACK] STREAM [OTHER_STREAM]
+ */
+
+int main(int argc,char **argv)
+{
+  std::vector<hash_entry> stream,other;
+  std::vector<level_def> pack;
+  level_board board;
+  zobrist_keys keys;
+  game_state state;
+  undo_ring history={};
+  uint64_t hash=0;
+  int level=0;
+  int outcome=MOVE_OK;
+  size_t i;
+
+  if(argc>2 && !strcmp(argv[1],"--levels"))
+  {
+    if(!read_level_pack(argv[2],&pack))
+      return 2;
+    argc-=2;
+    argv+=2;
+  }
+  else
+    builtin_pack(&pack);
+  if(argc<2 || !read_hash_stream(argv[1],&stream))
+  {
+    printf("usage: replay [--levels PACK] STREAM [OTHER_STREAM]\n");
+    return 2;
+  }
+  if(argc>2)
+  {
+    if(!read_hash_stream(argv[2],&other))
+    {
+      printf("Cannot read hash stream %s\n",argv[2]);
+      return 2;
+    }
+    long n=first_divergence(stream,other);
+    if(n>=0)
+    {
+      printf("Streams diverge at move %ld (level %d)\n",n+1,stream[n].level);
+      return 1;
+    }
+    if(stream.size()!=other.size())
+      printf("Streams agree on the first %d moves, lengths %d and %d\n",(int)std::min(stream.size(),other.size()),(int)stream.size(),(int)other.size());
+    else
+      printf("Streams match, %d moves\n",(int)stream.size());
+    return stream.size()!=other.size();
+  }
+
+  std::chrono::steady_clock::time_point t=std::chrono::steady_clock::now();
+  for(i=0;i<stream.size();i++)
+  {
+    const hash_entry *e=&stream[i];
+
+    // every level starts afresh, as it does in the game
+    if(e->level!=level)
+    {
+      if(e->level<1 || e->level>(int)pack.size())
+      {
+        printf("Move %d: no level %d\n",(int)i+1,e->level);
+        return 1;
+      }
+      level=e->level;
+      load_level(&board,&pack[level-1]);
+      init_zobrist(&keys,&board);
+      start_level(&state,&pack[level-1]);
+      state.no_of_moves=0;
+      hash=zobrist_hash(&keys,&board,&state);
+      undo_reset(&history,&state);
+      outcome=MOVE_OK;
+    }
+    // a fall can still be undone, a cleared level can't
+    else if(outcome==MOVE_GOAL || (outcome==MOVE_FALL && e->dir<NUM_DIRS))
+    {
+      printf("Move %d: level %d already ended\n",(int)i+1,level);
+      return 1;
+    }
+
+    game_state before=state;
+    if(e->dir==HASH_UNDO || e->dir==HASH_REDO)
+    {
+      if(!undo_step(&history,&state,(e->dir==HASH_UNDO) ? -1 : 1,outcome==MOVE_FALL))
+      {
+        printf("Move %d: nothing to %s\n",(int)i+1,(e->dir==HASH_UNDO) ? "undo" : "redo");
+        return 1;
+      }
+      outcome=MOVE_OK;
+    }
+    else
+    {
+      outcome=step(&board,&state,e->dir);
+      undo_record(&history,&state,outcome);
+    }
+    hash=zobrist_update(&keys,&board,hash,&before,&state);
+    if(hash!=e->hash)
+    {
+      printf("Replay diverges at move %d (level %d): recorded %016llx, replayed %016llx\n",
+          (int)i+1,level,(unsigned long long)e->hash,(unsigned long long)hash);
+      return 1;
+    }
+  }
+  double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t).count();
+  printf("Replay matches, %d moves in %.3f ms\n",(int)stream.size(),seconds*1e3);
+  return 0;
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+
+#include "rules.h"
+
+int dir_from_rotate_check(int rotate_check)
+{
+  switch(rotate_check)
+  {
+    case -1: return DIR_LEFT;
+    case 1: return DIR_RIGHT;
+    case 2: return DIR_UP;
+    default: return DIR_DOWN;
+  }
+}
+
+void place_block(game_state *s,int x,int z)
+{
+  s->block=pack_block(x,z,ORIENT_STANDING);
+  s->switch_check=0;
+  s->damage=0;
+  s->tick=0;
+}
+
+static void set_bit(bitboard &m,int i)
+{
+  m[i>>6]|=1ull<<(i&63);
+}
+
+static void clear_bit(bitboard &m,int i)
+{
+  m[i>>6]&=~(1ull<<(i&63));
+}
+
+void clear_board(level_board *b,int width,int height)
+{
+  b->width=width;
+  b->height=height;
+  b->stride=height+2*BOARD_PAD;
+  b->second_cell[ORIENT_STANDING]=0;
+  b->second_cell[ORIENT_LYING_X]=b->stride;
+  b->second_cell[ORIENT_LYING_Z]=1;
+  b->tiles.assign((width+2*BOARD_PAD)*b->stride,TILE_VOID);
+}
+
+void index_board(level_board *b)
+{
+  int cells=b->tiles.size();
+  int i;
+
+  b->crumble_count=0;
+  b->group.assign(cells,0);
+  b->target.assign(cells,0);
+  b->present.assign(cells,0);
+  b->period=1;
+  for(i=0;i<cells;i++)
+  {
+    int t=b->tiles[i];
+    int x=i/b->stride-BOARD_PAD;
+    int z=i%b->stride-BOARD_PAD;
+
+    if(t>=NUM_TILES)
+    {
+      fprintf(stderr,"Unknown tile %d at %d %d\n",t,x,z);
+      t=TILE_VOID;
+    }
+    if(t==TILE_CRUMBLE)
+    {
+      // each crumble tile owns one bit of game_state.damage
+      if(b->crumble_count==MAX_CRUMBLE)
+      {
+        fprintf(stderr,"More than %d crumble tiles, %d %d kept as normal\n",MAX_CRUMBLE,x,z);
+        t=TILE_NORMAL;
+      }
+      else
+        b->group[i]=b->crumble_count++;
+    }
+    if(t==TILE_TELEPORT)
+      b->target[i]=pack_block(x,z,ORIENT_STANDING);
+    b->tiles[i]=t;
+  }
+
+  int words=(cells+63)/64;
+  b->flags.resize(cells);
+  for(i=0;i<NUM_TILES;i++)
+    b->mask[i].assign(words,0);
+  b->solid.assign(words,0);
+  for(i=0;i<cells;i++)
+  {
+    b->flags[i]=tile_rules[b->tiles[i]].flags;
+    set_bit(b->mask[b->tiles[i]],i);
+    if(b->flags[i]&TF_SOLID)
+      set_bit(b->solid,i);
+    if(b->tiles[i]==TILE_TIMED)
+      set_timing(b,i/b->stride-BOARD_PAD,i%b->stride-BOARD_PAD,2,1);
+  }
+}
+
+void set_tile(level_board *b,int x,int z,int t)
+{
+  int i=cell_index(b,x,z);
+  int old=b->tiles[i];
+
+  if(t>=NUM_TILES)
+  {
+    fprintf(stderr,"Unknown tile %d at %d %d\n",t,x,z);
+    t=TILE_VOID;
+  }
+  if(t==TILE_CRUMBLE && b->crumble_count==MAX_CRUMBLE)
+  {
+    fprintf(stderr,"More than %d crumble tiles, %d %d kept as normal\n",MAX_CRUMBLE,x,z);
+    t=TILE_NORMAL;
+  }
+  if(t==old)
+    return;
+  clear_bit(b->mask[old],i);
+  clear_bit(b->solid,i);
+
+  b->tiles[i]=t;
+  b->flags[i]=tile_rules[t].flags;
+  b->group[i]=0;
+  b->target[i]=0;
+  b->present[i]=0;
+  set_bit(b->mask[t],i);
+  if(b->flags[i]&TF_SOLID)
+    set_bit(b->solid,i);
+  // a removed crumble tile's bit of game_state.damage is left unused
+  if(t==TILE_CRUMBLE)
+    b->group[i]=b->crumble_count++;
+  if(t==TILE_TELEPORT)
+    b->target[i]=pack_block(x,z,ORIENT_STANDING);
+  if(t==TILE_TIMED)
+    set_timing(b,x,z,2,1);
+  // with the last timed tile gone nothing repeats any more
+  if(old==TILE_TIMED)
+  {
+    size_t w;
+    for(w=0;w<b->mask[TILE_TIMED].size() && !b->mask[TILE_TIMED][w];w++);
+    if(w==b->mask[TILE_TIMED].size())
+      b->period=1;
+  }
+}
+
+void set_group(level_board *b,int x,int z,int g)
+{
+  b->group[cell_index(b,x,z)]=g%MAX_GROUPS;
+}
+
+void set_teleport(level_board *b,int x,int z,int tx,int tz)
+{
+  b->target[cell_index(b,x,z)]=pack_block(tx,tz,ORIENT_STANDING);
+}
+
+/* The on pattern of one period stretched over p ticks */
+static uint32_t repeat_pattern(uint32_t on,int period,int p)
+{
+  uint32_t r=0;
+  int t;
+
+  for(t=0;t<p;t++)
+    r|=((on>>(t%period))&1)<<t;
+  return r;
+}
+
+void set_timing(level_board *b,int x,int z,int period,uint32_t on)
+{
+  int p=b->period;
+  size_t i;
+
+  if(period>=1)
+    while(p%period && p<=MAX_PERIOD)
+      p+=b->period;
+  if(period<1 || p>MAX_PERIOD)
+  {
+    fprintf(stderr,"Timed tile %d %d with period %d makes the board's period more than %d, left as it was\n",x,z,period,MAX_PERIOD);
+    return;
+  }
+  if(p!=b->period)
+    for(i=0;i<b->present.size();i++)
+      if(b->flags[i]&TF_TIMED)
+        b->present[i]=repeat_pattern(b->present[i],b->period,p);
+  b->period=p;
+  b->present[cell_index(b,x,z)]=repeat_pattern(on,period,p);
+}
+
+/* Does cell c hold the block up in state s? A retracted bridge, a broken
+   crumble tile or a timed tile away this tick holds nothing. */
+static inline int holds(const level_board *b,const game_state *s,int c)
+{
+  unsigned f=b->flags[c];
+  int g=b->group[c];
+  int solid=(f&TF_SOLID)!=0;
+  int broken=((f&TF_CRUMBLE)!=0) & (int)((s->damage>>g)&1);
+  int away=((f&TF_TIMED)!=0) & (int)(~(b->present[c]>>s->tick)&1);
+  int bridge=((f&TF_BRIDGE)!=0) & (int)((s->switch_check>>g)&1);
+
+  return (solid&!broken&!away) | bridge;
+}
+
+int tile_present(const level_board *b,const game_state *s,int x,int z)
+{
+  return holds(b,s,cell_index(b,x,z));
+}
+
+/* Resolve the block having come to rest where s->block says */
+static int land(const level_board *b,game_state *s,int teleported)
+{
+  int o=block_orient(s->block);
+
+  // the two cells under the block, the same cell twice when standing
+  int c0=cell_index(b,block_x(s->block),block_z(s->block));
+  int c1=c0+b->second_cell[o];
+  unsigned f0=b->flags[c0];
+  unsigned f1=b->flags[c1];
+  int standing=(o==ORIENT_STANDING);
+
+  int held=holds(b,s,c0)&holds(b,s,c1);
+  int press0=presses(f0,standing);
+  int press1=presses(f1,standing);
+  int pressed=press0|press1;
+
+  if(falls(f0,f1,standing,held,pressed))
+    return MOVE_FALL;
+
+  if((f0|f1)&TF_SPECIAL)
+  {
+    if(f0&TF_CRUMBLE)
+      s->damage|=1u<<b->group[c0];
+    if(f1&TF_CRUMBLE)
+      s->damage|=1u<<b->group[c1];
+    if(standing && (f0&TF_TELEPORT) && !teleported)
+    {
+      s->block=b->target[c0];
+      return land(b,s,1);
+    }
+  }
+
+  if(standing & ((f0&TF_GOAL)!=0))
+    return MOVE_GOAL;
+  if(pressed)
+  {
+    // two switches of the same group under one block toggle it once
+    s->switch_check^=((uint32_t)press0<<b->group[c0]) | ((uint32_t)press1<<b->group[c1]);
+    return MOVE_SWITCH;
+  }
+  return MOVE_OK;
+}
+
+int step(const level_board *b,game_state *s,int dir)
+{
+  int o=block_orient(s->block);
+  int x=block_x(s->block)+roll_dx[o][dir];
+  int z=block_z(s->block)+roll_dz[o][dir];
+
+  s->block=pack_block(x,z,roll_orient[o][dir]);
+  s->no_of_moves++;
+  if(++s->tick>=(uint32_t)b->period)
+    s->tick=0;
+  return land(b,s,0);
+}
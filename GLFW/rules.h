@@ -0,0 +1,260 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Game rules without any GL/GLFW dependency.
+ *
+ * The block lives on a grid of tiles indexed board[x][z] exactly like the
+ * level arrays in Sample_GL3_2D.cpp. step() rolls the block one cell in a
+ * direction, resolves what it landed on and reports the outcome, so the same
+ * code drives the rendered game, bots and headless tools.
+ */
+
+/* Tile values as stored in the level arrays */
+enum {
+  TILE_VOID=0,
+  TILE_NORMAL=1,
+  TILE_FRAGILE=2,
+  TILE_BRIDGE=3,
+  TILE_SWITCH=4,        // toggles its bridges under any part of the block
+  TILE_HEAVY_SWITCH=5,  // toggles its bridges only under an upright block
+  TILE_GOAL=6,
+  TILE_TELEPORT=7,      // sends an upright block to its target cell
+  TILE_CRUMBLE=8,       // holds the block once, then is gone
+  TILE_TIMED=9,         // there only on some ticks, see set_timing()
+  NUM_TILES
+};
+
+/*
+ * Behaviour of each tile type, looked up once per cell by load_board().
+ * step() combines the flags of the cells under the block with bit tests,
+ * so a new tile type is a new row in tile_rules[] rather than a new branch.
+ */
+enum {
+  TF_SOLID=1<<0,      // holds the block up
+  TF_BRIDGE=1<<1,     // holds the block while its switch group is extended
+  TF_FRAGILE=1<<2,    // gives way under an upright block or a half-covering one
+  TF_SWITCH=1<<3,     // toggles its switch group when pressed
+  TF_HEAVY=1<<4,      // only an upright block presses it
+  TF_GOAL=1<<5,       // standing on it clears the level
+  TF_TELEPORT=1<<6,   // moves an upright block to the tile's target
+  TF_CRUMBLE=1<<7,    // breaks after holding the block once
+  TF_TIMED=1<<8,      // holds the block only on the ticks it is there
+  TF_SPECIAL=TF_TELEPORT|TF_CRUMBLE|TF_TIMED   // needs more than the flag tests
+};
+
+typedef struct tile_rule
+{
+  const char *name;
+  unsigned flags;   // TF_*
+  int palette;      // colour set the tile is drawn with, see chunks.h
+}tile_rule;
+
+// constexpr so levels can be checked while compiling, see levelcheck.h
+inline constexpr tile_rule tile_rules[NUM_TILES]={
+  { "void",         0,                          0 },
+  { "normal",       TF_SOLID,                   1 },
+  { "fragile",      TF_SOLID|TF_FRAGILE,        2 },
+  { "bridge",       TF_BRIDGE,                  3 },
+  { "switch",       TF_SOLID|TF_SWITCH,         4 },
+  { "heavy switch", TF_SOLID|TF_SWITCH|TF_HEAVY,5 },
+  { "goal",         TF_SOLID|TF_GOAL,           6 },
+  { "teleport",     TF_SOLID|TF_TELEPORT,       7 },
+  { "crumble",      TF_SOLID|TF_CRUMBLE,        8 },
+  { "timed",        TF_SOLID|TF_TIMED,          9 }
+};
+
+/* Block orientation: upright on one cell, or lying across two cells */
+enum {
+  ORIENT_STANDING=0,
+  ORIENT_LYING_X=1,   // covers (x,z) and (x+1,z)
+  ORIENT_LYING_Z=2    // covers (x,z) and (x,z+1)
+};
+
+/* Roll directions, in the order of the arrow keys */
+enum {
+  DIR_LEFT=0,   // -x
+  DIR_RIGHT=1,  // +x
+  DIR_UP=2,     // +z (towards the far end of the board)
+  DIR_DOWN=3,   // -z
+  NUM_DIRS=4
+};
+
+/* Cell offset and new orientation for each [orientation][direction] roll */
+inline constexpr int roll_dx[3][NUM_DIRS]={
+  //LEFT RIGHT UP DOWN
+  { -2, 1, 0, 0 },  // standing
+  { -1, 2, 0, 0 },  // lying along x
+  { -1, 1, 0, 0 }   // lying along z
+};
+inline constexpr int roll_dz[3][NUM_DIRS]={
+  { 0, 0, 1,-2 },
+  { 0, 0, 1,-1 },
+  { 0, 0, 2,-1 }
+};
+inline constexpr int roll_orient[3][NUM_DIRS]={
+  { ORIENT_LYING_X, ORIENT_LYING_X, ORIENT_LYING_Z, ORIENT_LYING_Z },
+  { ORIENT_STANDING, ORIENT_STANDING, ORIENT_LYING_X, ORIENT_LYING_X },
+  { ORIENT_LYING_Z, ORIENT_LYING_Z, ORIENT_STANDING, ORIENT_STANDING }
+};
+
+/*
+ * Landing tests on the flags of the two cells under the block (the same
+ * cell twice when it stands), shared by step() and the compile-time level
+ * checks.
+ */
+
+/* Does a block standing (or not) on a cell with flags f press its switch?
+   Heavy switches only give under the whole weight of the block. */
+static constexpr inline int presses(unsigned f,int standing)
+{
+  return ((f&TF_SWITCH)!=0) & (standing | ((f&TF_HEAVY)==0));
+}
+
+/* Does the block fall, given whether both cells hold it up and whether it
+   pressed a switch? Fragile tiles give way under an upright block, and
+   unless a switch is pressed, also under a block lying half on them. */
+static constexpr inline int falls(unsigned f0,unsigned f1,int standing,int held,int pressed)
+{
+  int fragile0=(f0&TF_FRAGILE)!=0;
+  int fragile1=(f1&TF_FRAGILE)!=0;
+
+  return (!held) | (standing&fragile0) | ((!pressed)&(fragile0^fragile1));
+}
+
+/* Result of a single roll */
+enum {
+  MOVE_OK=0,
+  MOVE_SWITCH=1,  // landed on a switch and toggled the bridges
+  MOVE_FALL=2,    // fell off the board or through a tile
+  MOVE_GOAL=3     // stood upright on the goal tile
+};
+
+/*
+ * The block is packed into one 32-bit word: bits 0-14 hold the x cell and
+ * bits 15-29 the z cell of the first cell it covers (two's complement, so a
+ * block that rolled off the low edge keeps its true position), bits 30-31
+ * the orientation. Copying, comparing and hashing a block is a single word.
+ */
+#define BLOCK_COORD_BITS 15
+#define BLOCK_COORD_MASK ((1u<<BLOCK_COORD_BITS)-1)
+
+static inline uint32_t pack_block(int x,int z,int orient)
+{
+  return ((uint32_t)x&BLOCK_COORD_MASK) | ((uint32_t)z&BLOCK_COORD_MASK)<<BLOCK_COORD_BITS | (uint32_t)orient<<30;
+}
+
+static inline int block_x(uint32_t b) { return (int32_t)(b<<17)>>17; }
+static inline int block_z(uint32_t b) { return (int32_t)(b<<2)>>17; }
+static inline int block_orient(uint32_t b) { return (int)(b>>30); }
+
+/* Switch groups and crumble tiles are tracked as bits of a 32-bit word,
+   and the ticks of a timed tile's pattern as bits of another */
+#define MAX_GROUPS 32
+#define MAX_CRUMBLE 32
+#define MAX_PERIOD 32
+
+typedef struct game_state
+{
+  uint32_t block;
+  uint32_t switch_check;  // bit g set while the bridges of group g are extended
+  uint32_t damage;        // bit i set once crumble tile i has broken
+  uint32_t tick;          // rolls so far modulo the board's period
+  int no_of_moves;
+}game_state;
+
+/*
+ * Board storage is padded with BOARD_PAD rings of TILE_VOID on every side.
+ * A block standing on the board reaches at most two cells past the edge in
+ * one roll, so every landing lookup is a plain load with no bounds test and
+ * rolling off the grid simply lands on void.
+ */
+#define BOARD_PAD 2
+
+/*
+ * Alongside the tile bytes the board keeps one bitmask per tile type over
+ * the same padded cell indices, so resolving a landing is a few bit tests
+ * and the solvers can work on whole masks at a time.
+ */
+typedef std::vector<uint64_t> bitboard;
+
+typedef struct level_board
+{
+  int width,height;
+  int stride;                        // height+2*BOARD_PAD
+  int second_cell[3];                // offset of the block's other cell, by orientation
+  int crumble_count;
+  std::vector<unsigned char> tiles;  // (width+2*BOARD_PAD)*stride values
+  std::vector<uint16_t> flags;       // tile_rules[tile].flags of every cell
+  std::vector<unsigned char> group;  // switch group of switches and bridges, bit of crumble tiles
+  std::vector<uint32_t> target;      // packed upright block a teleport sends the block to
+  std::vector<uint32_t> present;     // bit t of a timed tile set if it is there on tick t
+  int period;                        // ticks before every timed tile repeats, 1 with none
+  bitboard mask[NUM_TILES];          // cells of each tile type
+  bitboard solid;                    // cells that hold the block up while intact
+}level_board;
+
+static inline int test_bit(const bitboard &m,int i)
+{
+  return (int)(m[i>>6]>>(i&63))&1;
+}
+
+/* Map the game's block.rotate_check value (-1,1,2,-2) to a DIR_* index */
+int dir_from_rotate_check(int rotate_check);
+
+/* Put the block upright on (x,z) with the bridges retracted, every
+   crumble tile intact and the clock at tick 0 */
+void place_block(game_state *s,int x,int z);
+
+/*
+ * Filling a board takes two calls with the tiles written in between, which
+ * load_board() in board.h does for fixed and runtime-sized levels:
+ * clear_board() sizes b for a width x height level with every cell void,
+ * and index_board() derives flags, groups and masks from b->tiles. Every
+ * switch and bridge starts in group 0, as in the built-in levels.
+ */
+void clear_board(level_board *b,int width,int height);
+void index_board(level_board *b);
+
+/* Storage index of cell (x,z); valid for cells up to BOARD_PAD off the board */
+static inline int cell_index(const level_board *b,int x,int z)
+{
+  return (x+BOARD_PAD)*b->stride+z+BOARD_PAD;
+}
+
+/* Tile under cell (x,z); cells in the padding read as TILE_VOID */
+static inline int tile_at(const level_board *b,int x,int z)
+{
+  return b->tiles[cell_index(b,x,z)];
+}
+
+/* Change the tile at (x,z) to t after the board is indexed, as a level
+   editor does; a new switch or bridge is in group 0 and a new teleport
+   sends the block back onto itself. */
+void set_tile(level_board *b,int x,int z,int t);
+
+/* Bind the switch or bridge at (x,z) to switch group g */
+void set_group(level_board *b,int x,int z,int g);
+
+/* Make the teleport at (x,z) send the block to (tx,tz) */
+void set_teleport(level_board *b,int x,int z,int tx,int tz);
+
+/*
+ * Timed tiles come and go with the rolls: a roll advances the tick, and
+ * the block lands on a timed tile only if it is there on the new tick. The
+ * tile at (x,z) is there on the ticks t with bit t%period of on set, and
+ * the board's period becomes the least common multiple of its tiles'. A
+ * new timed tile is there on every other tick, from tick 0.
+ */
+void set_timing(level_board *b,int x,int z,int period,uint32_t on);
+
+/* Is the tile at (x,z) there to be drawn and stood on right now? */
+int tile_present(const level_board *b,const game_state *s,int x,int z);
+
+/* Roll the block one cell in direction dir and resolve the landing */
+int step(const level_board *b,game_state *s,int dir);
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "save.h"
+
+static_assert(sizeof(save_record)==48,"save_record layout changed, bump SAVE_VERSION");
+
+static const char *save_errors[]={
+  "ok",
+  "cannot read file",
+  "not a save file",
+  "unsupported save version",
+  "checksum mismatch",
+  "saved against a different level pack"
+};
+
+const char *save_error(int status)
+{
+  return save_errors[status];
+}
+
+static uint64_t checksum(const save_record *r)
+{
+  const unsigned char *p=(const unsigned char *)r;
+  uint64_t h=0xcbf29ce484222325ull;
+  size_t i;
+
+  for(i=0;i<offsetof(save_record,checksum);i++)
+    h=(h^p[i])*0x100000001b3ull;
+  return h;
+}
+
+int save_game(const char *path,uint64_t pack_id,int level,const game_state *s)
+{
+  save_record r;
+  char tmp[4096];
+
+  memset(&r,0,sizeof(r));
+  r.magic=SAVE_MAGIC;
+  r.version=SAVE_VERSION;
+  r.pack_id=pack_id;
+  r.level=level;
+  r.block=s->block;
+  r.switch_check=s->switch_check;
+  r.damage=s->damage;
+  r.tick=s->tick;
+  r.no_of_moves=s->no_of_moves;
+  r.checksum=checksum(&r);
+
+  // write beside the old snapshot and rename over it, so a crash mid-write
+  // leaves the previous checkpoint intact
+  if(snprintf(tmp,sizeof(tmp),"%s.tmp",path)>=(int)sizeof(tmp))
+    return SAVE_IO;
+  int fd=open(tmp,O_WRONLY|O_CREAT|O_TRUNC,0644);
+  if(fd<0)
+    return SAVE_IO;
+  int ok=(write(fd,&r,sizeof(r))==(ssize_t)sizeof(r));
+  ok&=(close(fd)==0);
+  if(!ok || rename(tmp,path)!=0)
+  {
+    unlink(tmp);
+    return SAVE_IO;
+  }
+  return SAVE_OK;
+}
+
+int load_game(const char *path,uint64_t pack_id,int levels,int *level,game_state *s)
+{
+  struct stat st;
+  int fd=open(path,O_RDONLY);
+
+  if(fd<0)
+    return SAVE_IO;
+  if(fstat(fd,&st)!=0 || st.st_size!=(off_t)sizeof(save_record))
+  {
+    close(fd);
+    return SAVE_IO;
+  }
+  void *map=mmap(NULL,sizeof(save_record),PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+    return SAVE_IO;
+
+  const save_record *r=(const save_record *)map;
+  int status=SAVE_OK;
+  if(r->magic!=SAVE_MAGIC)
+    status=SAVE_BAD_MAGIC;
+  else if(r->version!=SAVE_VERSION && r->version!=SAVE_VERSION_NO_TICK)
+    status=SAVE_BAD_VERSION;
+  else if(r->checksum!=checksum(r))
+    status=SAVE_BAD_CHECKSUM;
+  else if(r->pack_id!=pack_id || r->level<1 || r->level>levels)
+    status=SAVE_WRONG_PACK;
+  else
+  {
+    *level=r->level;
+    s->block=r->block;
+    s->switch_check=r->switch_check;
+    s->damage=r->damage;
+    s->tick=(r->version==SAVE_VERSION_NO_TICK) ? 0 : r->tick;
+    s->no_of_moves=r->no_of_moves;
+  }
+  munmap(map,sizeof(save_record));
+  return status;
+}
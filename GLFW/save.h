@@ -0,0 +1,53 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include "rules.h"
+
+/*
+ * Session snapshots: one fixed-layout record holding the level and the
+ * packed game_state, written in a single write() and read back by mapping
+ * the file, so checkpointing after every roll and resuming are both a few
+ * microseconds. Fields are stored in host byte order; the version changes
+ * whenever the layout does.
+ */
+#define SAVE_MAGIC 0x5a4f4c42u   // "BLOZ" read little-endian
+#define SAVE_VERSION 2
+#define SAVE_VERSION_NO_TICK 1   // tick was a reserved word, always zero; still read
+
+typedef struct save_record
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t pack_id;        // level_pack_id() of the levels it was saved against
+  int32_t level;
+  uint32_t block;
+  uint32_t switch_check;
+  uint32_t damage;
+  int32_t no_of_moves;
+  uint32_t tick;           // since version 2
+  uint64_t checksum;       // FNV-1a of every byte before it
+}save_record;
+
+/* Why a snapshot was rejected */
+enum {
+  SAVE_OK=0,
+  SAVE_IO,           // missing, unreadable or the wrong size
+  SAVE_BAD_MAGIC,    // not a snapshot at all
+  SAVE_BAD_VERSION,  // written by an incompatible build
+  SAVE_BAD_CHECKSUM, // damaged
+  SAVE_WRONG_PACK    // saved against different levels
+};
+
+const char *save_error(int status);
+
+/* Write level and s, played in the pack with level_pack_id() pack_id, to
+   path, replacing it only once the new snapshot is complete. Returns a
+   SAVE_* status. */
+int save_game(const char *path,uint64_t pack_id,int level,const game_state *s);
+
+/* Read a snapshot written by save_game() against the same pack of levels
+   levels; *level and *s are only touched when it is accepted. Returns a
+   SAVE_* status. */
+int load_game(const char *path,uint64_t pack_id,int levels,int *level,game_state *s);
+
+#endif
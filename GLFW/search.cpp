@@ -0,0 +1,124 @@
+#include <chrono>
+
+#include "search.h"
+
+void init_state_table(state_table *t,int capacity)
+{
+  int n=16;
+
+  while(n<2*capacity)
+    n<<=1;
+  t->slot.assign(n,0);
+  t->count=0;
+}
+
+/* Slot holding s, or the empty slot it belongs in */
+static int probe(const state_table *t,const std::vector<game_state> &states,const game_state *s)
+{
+  int mask=t->slot.size()-1;
+  int i=state_hash(s)&mask;
+
+  while(t->slot[i] && !same_state(&states[t->slot[i]-1],s))
+    i=(i+1)&mask;
+  return i;
+}
+
+int find_or_add_state(state_table *t,const std::vector<game_state> &states,int n)
+{
+  int i=probe(t,states,&states[n]);
+
+  if(t->slot[i])
+    return t->slot[i]-1;
+
+  t->slot[i]=n+1;
+  // keep the load under a half so probes stay short
+  if(++t->count*2>(int)t->slot.size())
+  {
+    std::vector<int32_t> old;
+    old.swap(t->slot);
+    t->slot.assign(old.size()*2,0);
+    for(i=0;i<(int)old.size();i++)
+      if(old[i])
+        t->slot[probe(t,states,&states[old[i]-1])]=old[i];
+  }
+  return -1;
+}
+
+/* Breadth-first search from start, stopping at the first goal unless all */
+static void bfs(const level_board *b,const game_state *start,int all,solve_result *r)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  std::vector<game_state> states;     // in the order reached, which is the queue
+  std::vector<int32_t> parent;
+  std::vector<unsigned char> via;     // direction rolled to reach each state
+  std::vector<unsigned char> ended;   // standing on the goal, not rolled on from
+  state_table seen;
+  int head,goal=-1;
+  int dir;
+
+  states.push_back(*start);
+  states[0].no_of_moves=0;
+  parent.push_back(-1);
+  via.push_back(0);
+  ended.push_back(0);
+  init_state_table(&seen,1024);
+  find_or_add_state(&seen,states,0);
+
+  for(head=0;head<(int)states.size() && (all || goal<0);head++)
+  {
+    if(ended[head])
+      continue;
+    for(dir=0;dir<NUM_DIRS;dir++)
+    {
+      game_state s=states[head];
+      int outcome=step(b,&s,dir);
+
+      if(outcome==MOVE_FALL)
+        continue;
+      // no_of_moves isn't part of a state, the path length is
+      s.no_of_moves=0;
+      states.push_back(s);
+      if(find_or_add_state(&seen,states,states.size()-1)>=0)
+      {
+        states.pop_back();
+        continue;
+      }
+      parent.push_back(head);
+      via.push_back(dir);
+      ended.push_back(outcome==MOVE_GOAL);
+      // every roll costs the same, so the first goal reached is optimal
+      if(outcome==MOVE_GOAL && goal<0)
+        goal=states.size()-1;
+      if(outcome==MOVE_GOAL && !all)
+        break;
+    }
+  }
+
+  r->path.clear();
+  for(int n=goal;n>0;n=parent[n])
+    r->path.insert(r->path.begin(),via[n]);
+  r->moves=(goal<0) ? -1 : (int)r->path.size();
+  r->gave_up=0;
+  r->states=states.size();
+  r->seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+void solve_bfs(const level_board *b,const game_state *start,solve_result *r)
+{
+  bfs(b,start,0,r);
+}
+
+void explore_bfs(const level_board *b,const game_state *start,solve_result *r)
+{
+  bfs(b,start,1,r);
+}
+
+std::string path_string(const std::vector<unsigned char> &path)
+{
+  std::string s;
+  size_t i;
+
+  for(i=0;i<path.size();i++)
+    s+="LRUD"[path[i]];
+  return s;
+}
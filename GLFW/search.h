@@ -0,0 +1,212 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <string>
+
+#include "rules.h"
+
+/*
+ * Optimal solving of a level. The searches run over game states (the
+ * block word, the switch groups, the crumble damage and the tick of the
+ * board's period) and take every roll through step(), so a solution is
+ * exactly what the game accepts and its length is the level's par.
+ */
+typedef struct solve_result
+{
+  int moves;                          // fewest rolls to stand on the goal, -1 if it can't be done
+  int gave_up;                        // ran out of room before finding out, moves is -1
+  std::vector<unsigned char> path;    // DIR_* of one optimal solution
+  long states;                        // distinct states reached
+  double seconds;
+}solve_result;
+
+/*
+ * Visited states as an open-addressed table of indices into a caller's
+ * state array, so the table itself is one int per slot and the states are
+ * stored once.
+ */
+typedef struct state_table
+{
+  std::vector<int32_t> slot;   // state index+1, 0 while empty
+  int count;
+}state_table;
+
+static inline uint64_t state_hash(const game_state *s)
+{
+  uint64_t h=((uint64_t)s->switch_check<<32 | s->block) ^ (uint64_t)s->damage*0x9e3779b97f4a7c15ull;
+  h^=(uint64_t)s->tick*0xc2b2ae3d27d4eb4full;
+  h=(h^(h>>31))*0xbf58476d1ce4e5b9ull;
+  return h^(h>>29);
+}
+
+static inline int same_state(const game_state *a,const game_state *b)
+{
+  return a->block==b->block && a->switch_check==b->switch_check && a->damage==b->damage && a->tick==b->tick;
+}
+
+void init_state_table(state_table *t,int capacity);
+
+/* Index of s among states[] if the table holds it; otherwise add it as
+   index n (states[n] must already hold it) and return -1 */
+int find_or_add_state(state_table *t,const std::vector<game_state> &states,int n);
+
+/* Breadth-first search from start */
+void solve_bfs(const level_board *b,const game_state *start,solve_result *r);
+
+/* solve_bfs() carried on past the goal, so r->states counts every state
+   reachable from start, a state on the goal ending the level */
+void explore_bfs(const level_board *b,const game_state *start,solve_result *r);
+
+/* Breadth-first search a layer at a time, rolling every block of one
+   orientation and switch state with a few word operations; see
+   bitsearch.cpp. Gives the same moves as solve_bfs() and counts every
+   state of the last layer, but no path. Timed tiles cost a copy of the
+   masks per tick of the period; boards with teleport or crumble tiles are
+   handed to solve_bfs(). */
+void solve_bitbfs(const level_board *b,const game_state *start,solve_result *r);
+
+/* Breadth-first search with each layer expanded by threads that steal
+   work from each other, into a lock-free visited set; see parsearch.cpp.
+   Gives the same moves as solve_bfs(), and the same states when the level
+   can't be cleared. Boards with crumble or timed tiles are handed to
+   solve_bfs(). */
+void solve_parallel(const level_board *b,const game_state *start,int threads,solve_result *r);
+
+/*
+ * A* search: states are taken in order of rolls so far plus a lower bound
+ * on the rolls still needed (see astar.cpp), so it stops long before BFS
+ * would when the goal is near. Memory is fixed when the search starts: a
+ * node pool of the given size and a transposition table of pool indices
+ * keyed by state_hash(); a search that fills the pool gives up. It is also
+ * resumable, as astar_run() does a given number of expansions and picks up
+ * where it stopped, which lets the game spread a hint over frames.
+ */
+typedef struct astar_target
+{
+  int x2,z2;   // doubled centre of a block standing on the cell
+  int cost;    // fewest rolls still needed once standing there
+}astar_target;
+
+typedef struct astar_node
+{
+  game_state s;         // no_of_moves holds the rolls from the start
+  int32_t parent;
+  unsigned char dir;    // roll that led here
+}astar_node;
+
+typedef struct astar_search
+{
+  const level_board *board;
+  std::vector<astar_target> targets;   // goals, and teleports that lead to them
+  std::vector<astar_node> nodes;       // reserved up front, never past capacity
+  int capacity;
+  std::vector<int32_t> table;          // node index+1, 0 while empty
+  std::vector<std::vector<int32_t> > open;   // nodes by estimated total
+  int f;                               // lowest bucket that may hold nodes
+  long expanded;
+  int done;
+  int full;                            // gave up with the pool full
+  int moves;                           // as solve_result, once done
+  std::vector<unsigned char> path;
+}astar_search;
+
+/* Start a search from start that keeps at most capacity states */
+void astar_start(astar_search *s,const level_board *b,const game_state *start,int capacity);
+
+/* Expand up to max_nodes more states; returns s->done */
+int astar_run(astar_search *s,long max_nodes);
+
+/* Lower bound on the rolls from g to the goal */
+int astar_estimate(const astar_search *s,const game_state *g);
+
+/* solve_bfs() by A*, with the same moves and states counting the
+   distinct states reached; on a board whose states don't fit the node
+   pool it may give up, setting r->gave_up */
+void solve_astar(const level_board *b,const game_state *start,solve_result *r);
+
+/* Breadth-first search with the layers in files under dir, using about
+   memory bytes of RAM; see extsearch.cpp. A search of the same board and
+   start that was cut short picks up after its last complete layer.
+   Gives the same moves and path length as solve_bfs(), and the same
+   states when the level can't be cleared. Returns 0 if the files can't
+   be written or read. */
+int solve_external(const level_board *b,const game_state *start,const char *dir,long memory,solve_result *r);
+
+/*
+ * Rolls to the goal from the start of a board, kept up to date while its
+ * tiles are edited one at a time, for a level editor that wants the par
+ * and whether the level can be cleared after every change; see
+ * editsearch.cpp. The tables have every state's rolls and its distance
+ * to the goal as last worked out. An edit only rolls again into the cells
+ * it changed, and then only settles the distances that can change the
+ * start's, leaving the rest queued for the edits after it. Besides the cell and the
+ * orientation a state has a digit for each switch group, crumble tile and
+ * the tick as far as they matter: a group, tile or tick an edit brings in
+ * grows the tables in place, and one an edit leaves with nothing to do is
+ * dropped again when it was the last added. Boards with too many states
+ * for the tables are solved from scratch by solve_bfs() after every edit
+ * instead. On a 100x100 board an edit takes 2-4 ms on average, but one
+ * that moves the start's way to the goal a long way can take over 100 ms.
+ */
+#define EDIT_MAX_STATES (1<<22)
+
+enum {
+  EDIT_DIM_GROUP,    // a switch group's bit of switch_check
+  EDIT_DIM_DAMAGE,   // a crumble tile's bit of damage
+  EDIT_DIM_TICK      // the tick, as many values as the period
+};
+
+typedef struct edit_dim
+{
+  int kind;      // EDIT_DIM_*
+  int id;        // the group or the damage bit
+  int size;      // values the digit takes
+  long stride;   // planes between one value and the next
+}edit_dim;
+
+/* A state waiting to be settled, in order of key then dist */
+typedef struct edit_entry
+{
+  int32_t key;      // dist plus the fewest rolls it can be from the start
+  int32_t dist;     // the lower of its dist and rhs when queued
+  int32_t state;
+}edit_entry;
+
+typedef struct edit_search
+{
+  level_board board;                // own copy, changed by edit_tile()
+  game_state start;
+  int cells;
+  long planes;                      // states of everything but the block, the product of the sizes
+  std::vector<edit_dim> dims;       // in the order they were added, the last outermost
+  int group_dim[MAX_GROUPS];        // index in dims of each group, -1 if left out
+  int damage_dim[MAX_CRUMBLE];      // and of each damage bit
+  int tick_dim;                     // and of the tick
+  std::vector<int> teleports;       // cells of the teleport tiles
+  std::vector<int> teleport_to;     // and the cells they send the block to
+  std::vector<int32_t> next;        // NUM_DIRS per state: the state a roll leads to, or EDGE_*
+  std::vector<int32_t> dist;        // rolls to the goal as last settled, EDIT_NO_WAY for none
+  std::vector<int32_t> rhs;         // one more than the least dist a roll from the state reaches
+  std::vector<edit_entry> queue;    // heap of the states whose dist and rhs differ, and stale entries
+  int guided;                       // keys count rolls from the start; not with teleports about
+  int tracked;                      // 0 when solve_bfs() is used instead of the tables
+  int moves;                        // as solve_result
+  long repaired;                    // distances the last edit settled
+  double seconds;                   // the last edit took
+}edit_search;
+
+enum { EDGE_FALL=-1, EDGE_GOAL=-2 };
+#define EDIT_NO_WAY 0x3fffffff
+
+/* Build the tables for a copy of b with the block starting at start;
+   sets e->moves */
+void edit_start(edit_search *e,const level_board *b,const game_state *start);
+
+/* set_tile() on the copy, bring the tables up to date and return the
+   rolls from the start to the goal, -1 if there is no way any more */
+int edit_tile(edit_search *e,int x,int z,int tile);
+
+/* Solution as the arrow key letters, e.g. "RRDLU" */
+std::string path_string(const std::vector<unsigned char> &path);
+
+#endif
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "rules.h"
+#include "levels.h"
+#include "search.h"
+
+/*
+ * Headless check and benchmark for the solvers: first compares
+ * solve_bitbfs(), solve_parallel() and solve_astar() against solve_bfs() on
+ * the built-in levels, with the states BFS and A* reach on each, and on
+ * many small random boards, with and without timed tiles, and
+ * solve_external() on some of them with a few kilobytes of RAM so its
+ * layers take many runs, and edit_tile() after random one-tile edits.
+ * Then it times the searches on random boards of growing size, an edit
+ * and its verdict on 100x100 boards, on average and at worst, with edits
+ * to crumble and timed tiles (which grow the tables) apart, and the
+ * parallel search on 1, 2, 4... threads up to the most given (the
+ * hardware's threads by default).
+ *
+ *   ./solvebench [largest side] [boards per size] [most threads]
+ */
+
+static uint64_t rng_state=88172645463325252ull;
+
+static uint32_t next_random()
+{
+  rng_state^=rng_state<<13;
+  rng_state^=rng_state>>7;
+  rng_state^=rng_state<<17;
+  return (uint32_t)rng_state;
+}
+
+/* A random side x side board of normal tiles with holes, fragile tiles and
+   a few switches and bridges in four groups; the block starts upright in
+   the middle and the goal is somewhere else. */
+static void random_board(level_board *b,int side,game_state *start)
+{
+  Board<Dynamic> level(side,side);
+  int x,z;
+
+  for(x=0;x<side;x++)
+  {
+    for(z=0;z<side;z++)
+    {
+      int p=next_random()%100;
+      int t=TILE_NORMAL;
+      if(p<22)
+        t=TILE_VOID;
+      else if(p<28)
+        t=TILE_FRAGILE;
+      else if(p<31)
+        t=TILE_BRIDGE;
+      else if(p<32)
+        t=TILE_SWITCH;
+      else if(p<33)
+        t=TILE_HEAVY_SWITCH;
+      level.set(x,z,t);
+    }
+  }
+  int sx=side/2,sz=side/2;
+  level.set(sx,sz,TILE_NORMAL);
+  int gx,gz;
+  do
+  {
+    gx=next_random()%side;
+    gz=next_random()%side;
+  }while(gx==sx && gz==sz);
+  level.set(gx,gz,TILE_GOAL);
+
+  load_board(b,level);
+  for(x=0;x<side;x++)
+    for(z=0;z<side;z++)
+      if(tile_at(b,x,z)==TILE_BRIDGE || tile_at(b,x,z)==TILE_SWITCH || tile_at(b,x,z)==TILE_HEAVY_SWITCH)
+        set_group(b,x,z,next_random()%4);
+  place_block(start,sx,sz);
+  start->no_of_moves=0;
+}
+
+/* Turn about one normal tile in eight into a timed tile, there on a
+   random pattern of 2, 3 or 4 ticks */
+static void add_timed_tiles(level_board *b,const game_state *start)
+{
+  int x,z;
+
+  for(x=0;x<b->width;x++)
+  {
+    for(z=0;z<b->height;z++)
+    {
+      if(tile_at(b,x,z)!=TILE_NORMAL || next_random()%8 ||
+          (x==block_x(start->block) && z==block_z(start->block)))
+        continue;
+      int period=2+next_random()%3;
+      set_tile(b,x,z,TILE_TIMED);
+      set_timing(b,x,z,period,next_random()%((1u<<period)-1)+1);
+    }
+  }
+}
+
+/* A returned path must be as long as its moves and clear the
+   level */
+static int clears(const level_board *b,const game_state *start,const solve_result *r)
+{
+  game_state s=*start;
+  size_t i;
+
+  if(r->moves<0)
+    return 1;
+  if((int)r->path.size()!=r->moves)
+    return 0;
+  for(i=0;i<r->path.size();i++)
+  {
+    int outcome=step(b,&s,r->path[i]);
+    if(outcome==MOVE_FALL || (outcome==MOVE_GOAL)!=(i+1==r->path.size()))
+      return 0;
+  }
+  return 1;
+}
+
+/* Empty and remove a directory of search files */
+static void remove_dir(const char *dir)
+{
+  DIR *d=opendir(dir);
+  struct dirent *e;
+  char path[4096];
+
+  while(d && (e=readdir(d)))
+  {
+    snprintf(path,sizeof(path),"%s/%s",dir,e->d_name);
+    unlink(path);
+  }
+  if(d)
+    closedir(d);
+  rmdir(dir);
+}
+
+/* Both searches must agree on the moves, and on the states reached when
+   the whole space was searched */
+static int same_result(const solve_result *a,const solve_result *b)
+{
+  return a->moves==b->moves && (a->moves>=0 || a->states==b->states);
+}
+
+int main(int argc,char **argv)
+{
+  int largest=(argc>1) ? atoi(argv[1]) : 512;
+  int boards=(argc>2) ? atoi(argv[2]) : 4;
+  int most=(argc>3) ? atoi(argv[3]) : std::thread::hardware_concurrency();
+  level_board board;
+  game_state start;
+  solve_result a,b,p,h,x;
+  edit_search edit;
+  char dir[]="/tmp/solvebench-XXXXXX";
+  int i,k,side,threads,solved=0;
+  long bfs_states=0,astar_states=0;   // over the solvable random boards
+
+  if(most<1)
+    most=1;
+  if(!mkdtemp(dir))
+  {
+    printf("Cannot make a directory for search files\n");
+    return 1;
+  }
+
+  for(i=1;i<=NUM_LEVELS;i++)
+  {
+    load_board(&board,*builtin_level(i));
+    place_block(&start,START_X,START_Z);
+    start.no_of_moves=0;
+    solve_bfs(&board,&start,&a);
+    solve_bitbfs(&board,&start,&b);
+    solve_parallel(&board,&start,4,&p);
+    solve_astar(&board,&start,&h);
+    if(!same_result(&a,&b) || !same_result(&a,&p) || !clears(&board,&start,&p) ||
+        !same_result(&a,&h) || !clears(&board,&start,&h))
+    {
+      printf("level %d: bfs %d moves, bit bfs %d moves, parallel %d moves, A* %d moves\n",i,a.moves,b.moves,p.moves,h.moves);
+      return 1;
+    }
+    printf("level %d: %d moves, bfs %ld states, A* %ld states (%.0f%% fewer)\n",
+        i,a.moves,a.states,h.states,100.0*(a.states-h.states)/a.states);
+  }
+  for(i=0;i<2000;i++)
+  {
+    random_board(&board,4+i%29,&start);
+    solve_bfs(&board,&start,&a);
+    solve_bitbfs(&board,&start,&b);
+    solve_parallel(&board,&start,1+i%4,&p);
+    solve_astar(&board,&start,&h);
+    if(!same_result(&a,&b) || !same_result(&a,&p) || !clears(&board,&start,&p) ||
+        !same_result(&a,&h) || !clears(&board,&start,&h))
+    {
+      printf("random board %d: bfs %d moves %ld states, bit bfs %d moves %ld states, parallel %d moves %ld states, A* %d moves %ld states\n",
+          i,a.moves,a.states,b.moves,b.states,p.moves,p.states,h.moves,h.states);
+      return 1;
+    }
+    if(i<200)
+    {
+      if(!solve_external(&board,&start,dir,4096,&x) || !same_result(&a,&x) || !clears(&board,&start,&x))
+      {
+        printf("random board %d: bfs %d moves %ld states, disk bfs %d moves %ld states\n",i,a.moves,a.states,x.moves,x.states);
+        return 1;
+      }
+    }
+    if(a.moves>=0)
+    {
+      solved++;
+      bfs_states+=a.states;
+      astar_states+=h.states;
+    }
+  }
+  printf("bit bfs, parallel bfs and A* match bfs on %d levels and 2000 random boards (%d solvable), disk bfs on 200\n",NUM_LEVELS,solved);
+  printf("on the solvable ones bfs reached %ld states, A* %ld (%.0f%% fewer)\n",
+      bfs_states,astar_states,100.0*(bfs_states-astar_states)/bfs_states);
+
+  solved=0;
+  for(i=0;i<500;i++)
+  {
+    random_board(&board,4+i%29,&start);
+    add_timed_tiles(&board,&start);
+    solve_bfs(&board,&start,&a);
+    solve_bitbfs(&board,&start,&b);
+    solve_parallel(&board,&start,2,&p);
+    solve_astar(&board,&start,&h);
+    if(!same_result(&a,&b) || !same_result(&a,&p) || !clears(&board,&start,&p) ||
+        !same_result(&a,&h) || !clears(&board,&start,&h) ||
+        (i<50 && (!solve_external(&board,&start,dir,4096,&x) || !same_result(&a,&x) || !clears(&board,&start,&x))))
+    {
+      printf("timed board %d (period %d): bfs %d moves %ld states, bit bfs %d moves %ld states, A* %d moves\n",
+          i,board.period,a.moves,a.states,b.moves,b.states,h.moves);
+      return 1;
+    }
+    solved+=(a.moves>=0);
+  }
+  remove_dir(dir);
+  printf("and on 500 boards with timed tiles (%d solvable), disk bfs on 50\n",solved);
+
+  for(i=0;i<300;i++)
+  {
+    random_board(&board,4+i%29,&start);
+    edit_start(&edit,&board,&start);
+    for(k=0;k<50;k++)
+    {
+      int x=next_random()%board.width;
+      int z=next_random()%board.height;
+      if(x==block_x(start.block) && z==block_z(start.block))
+        continue;
+      edit_tile(&edit,x,z,next_random()%NUM_TILES);
+      solve_bfs(&edit.board,&start,&a);
+      if(a.moves!=edit.moves)
+      {
+        printf("random board %d, edit %d at %d %d: bfs %d moves, edited %d moves\n",i,k,x,z,a.moves,edit.moves);
+        return 1;
+      }
+    }
+  }
+  printf("edited boards match bfs after 50 random edits each on 300 boards\n");
+
+  for(side=32;side<=largest;side*=2)
+  {
+    double t_bfs=0,t_bit=0;
+    long states=0;
+
+    for(i=0;i<boards;i++)
+    {
+      random_board(&board,side,&start);
+      solve_bfs(&board,&start,&a);
+      solve_bitbfs(&board,&start,&b);
+      if(!same_result(&a,&b))
+      {
+        printf("%dx%d board %d: bfs %d moves, bit bfs %d moves\n",side,side,i,a.moves,b.moves);
+        return 1;
+      }
+      t_bfs+=a.seconds;
+      t_bit+=b.seconds;
+      states+=a.states;
+    }
+    printf("%4dx%-4d bfs %8.2f ms, bit bfs %8.2f ms, %.1fx (%ld states per board)\n",
+        side,side,t_bfs*1e3/boards,t_bit*1e3/boards,t_bfs/t_bit,states/boards);
+  }
+
+  // a designer's edits: a tile changed and put back again
+  for(i=0;i<boards;i++)
+  {
+    double t_edit=0,t_worst=0,t_full=0,t_special=0,t_special_worst=0;
+    long repaired=0;
+
+    random_board(&board,100,&start);
+    edit_start(&edit,&board,&start);
+    for(k=0;k<1000;k++)
+    {
+      int x=next_random()%100;
+      int z=next_random()%100;
+      int old=tile_at(&board,x,z);
+      if(x==block_x(start.block) && z==block_z(start.block))
+        continue;
+      edit_tile(&edit,x,z,next_random()%TILE_TELEPORT);
+      t_edit+=edit.seconds;
+      t_worst=std::max(t_worst,edit.seconds);
+      repaired+=edit.repaired;
+      if(k%100==0)
+      {
+        solve_bfs(&edit.board,&start,&a);
+        t_full+=a.seconds;
+      }
+      edit_tile(&edit,x,z,old);
+      t_edit+=edit.seconds;
+      t_worst=std::max(t_worst,edit.seconds);
+      repaired+=edit.repaired;
+    }
+    printf(" 100x100  edit %8.3f ms, worst %6.2f ms, bfs %8.2f ms (%ld states in the tables, %ld settled per edit)\n",
+        t_edit*1e3/2000,t_worst*1e3,t_full*1e3/10,(long)edit.dist.size(),repaired/2000);
+
+    // a crumble or timed tile grows the tables by a damage bit or the
+    // tick, dropped again when it is put back
+    for(k=0;k<10;k++)
+    {
+      int x=next_random()%100;
+      int z=next_random()%100;
+      int old=tile_at(&board,x,z);
+      if(x==block_x(start.block) && z==block_z(start.block))
+        continue;
+      edit_tile(&edit,x,z,(k&1) ? TILE_TIMED : TILE_CRUMBLE);
+      t_special+=edit.seconds;
+      t_special_worst=std::max(t_special_worst,edit.seconds);
+      edit_tile(&edit,x,z,old);
+      t_special+=edit.seconds;
+      t_special_worst=std::max(t_special_worst,edit.seconds);
+    }
+    printf(" 100x100  crumble or timed edit %8.3f ms, worst %6.2f ms\n",t_special*1e3/20,t_special_worst*1e3);
+  }
+
+  // scaling of the parallel search on the largest boards; each board is
+  // drawn again from the same seed so every thread count sees the same ones
+  uint64_t seed=rng_state;
+  double t_one=0;
+  for(threads=1;threads<=most;threads=(threads==most) ? most+1 : std::min(threads*2,most))
+  {
+    double t_par=0;
+
+    rng_state=seed;
+    for(i=0;i<boards;i++)
+    {
+      random_board(&board,largest,&start);
+      solve_parallel(&board,&start,threads,&p);
+      t_par+=p.seconds;
+    }
+    if(threads==1)
+      t_one=t_par;
+    printf("%4dx%-4d parallel bfs, %2d threads %8.2f ms, %.2fx one thread\n",
+        largest,largest,threads,t_par*1e3/boards,t_one/t_par);
+  }
+  return 0;
+}
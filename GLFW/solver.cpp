@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rules.h"
+#include "levels.h"
+#include "search.h"
+
+/*
+ * Headless solver: finds the fewest rolls that clear a level, one optimal
+ * move string and how fast the states were searched. Levels are built-in
+ * level numbers or level packs (see levels.h), every level of which is
+ * solved; with none it solves every built-in level. Exits non-zero if any
+ * level can't be cleared or is off the par its pack gives; a level A*
+ * gives up on for want of room is reported but doesn't count.
+ * --bits solves with the bit-parallel search, which gives the moves but no
+ * solution; --threads N with the parallel search on N threads; --astar with
+ * A*, which reaches fewer states when the goal is near; --disk DIR with the
+ * layers kept in files under DIR and --memory MB of RAM (256 by default),
+ * resuming a search of the same level that was cut short.
+ *
+ *   ./solver [--bits | --astar | --threads N | --disk DIR [--memory MB]] [LEVEL|FILE]...
+ */
+
+typedef void (*solve_fn)(const level_board *,const game_state *,solve_result *);
+
+static solve_fn solve=solve_bfs;
+static int threads;
+static const char *disk_dir;
+static long disk_memory=256L<<20;
+
+static void solve_threaded(const level_board *b,const game_state *start,solve_result *r)
+{
+  solve_parallel(b,start,threads,r);
+}
+
+static void solve_on_disk(const level_board *b,const game_state *start,solve_result *r)
+{
+  if(!solve_external(b,start,disk_dir,disk_memory,r))
+  {
+    printf("Cannot use search files in %s\n",disk_dir);
+    exit(2);
+  }
+}
+
+static void report(const char *name,const solve_result *r)
+{
+  double rate=(r->seconds>0) ? r->states/r->seconds : 0;
+
+  if(r->gave_up)
+    printf("%s: gave up, %ld states in %.3f ms (%.1fM states/s)\n",name,r->states,r->seconds*1e3,rate/1e6);
+  else if(r->moves<0)
+    printf("%s: unsolvable, %ld states in %.3f ms (%.1fM states/s)\n",name,r->states,r->seconds*1e3,rate/1e6);
+  else
+    printf("%s: %d moves%s%s, %ld states in %.3f ms (%.1fM states/s)\n",
+        name,r->moves,r->path.empty() ? "" : " ",path_string(r->path).c_str(),r->states,r->seconds*1e3,rate/1e6);
+}
+
+/* Solve level l; returns 0 if it can't be cleared or is off its par, but
+   not if the search gave up without finding out */
+static int solve_one(const char *name,const level_def *l)
+{
+  level_board board;
+  game_state start;
+  solve_result r;
+
+  load_level(&board,l);
+  start_level(&start,l);
+  start.no_of_moves=0;
+  solve(&board,&start,&r);
+  report(name,&r);
+  if(r.moves>=0 && l->par>=0 && r.moves!=l->par)
+  {
+    printf("%s: the pack gives par %d\n",name,l->par);
+    return 0;
+  }
+  return r.moves>=0 || r.gave_up;
+}
+
+/* Solve the levels named by arg; returns 0 if they can't be loaded or any
+   can't be solved */
+static int solve_level(const char *arg)
+{
+  std::vector<level_def> pack;
+  char name[4096];
+  size_t i;
+  int ok=1;
+
+  if(!read_levels(arg,&pack))
+    return 0;
+  for(i=0;i<pack.size();i++)
+  {
+    if(pack.size()>1)
+      snprintf(name,sizeof(name),"%s:%d",arg,(int)i+1);
+    else
+      snprintf(name,sizeof(name),"%s",arg);
+    ok&=solve_one(name,&pack[i]);
+  }
+  return ok;
+}
+
+int main(int argc,char **argv)
+{
+  int ok=1;
+  int i,first=1;
+
+  for(;first<argc && !strncmp(argv[first],"--",2);first++)
+  {
+    if(!strcmp(argv[first],"--bits"))
+      solve=solve_bitbfs;
+    else if(!strcmp(argv[first],"--astar"))
+      solve=solve_astar;
+    else if(first+1<argc && !strcmp(argv[first],"--threads"))
+    {
+      threads=atoi(argv[++first]);
+      solve=solve_threaded;
+    }
+    else if(first+1<argc && !strcmp(argv[first],"--disk"))
+    {
+      disk_dir=argv[++first];
+      solve=solve_on_disk;
+    }
+    else if(first+1<argc && !strcmp(argv[first],"--memory"))
+      disk_memory=atol(argv[++first])<<20;
+    else
+    {
+      printf("Unknown option %s\n",argv[first]);
+      return 2;
+    }
+  }
+  if(argc<=first)
+  {
+    for(i=1;i<=NUM_LEVELS;i++)
+    {
+      char name[16];
+      snprintf(name,sizeof(name),"%d",i);
+      ok&=solve_level(name);
+    }
+  }
+  for(i=first;i<argc;i++)
+    ok&=solve_level(argv[i]);
+  return !ok;
+}
@@ -0,0 +1,75 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include "rules.h"
+
+/*
+ * Undo/redo history of one level, kept as a fixed ring of game_state
+ * snapshots. A snapshot is the packed block word, the switch and damage
+ * bits, the tick and the move count, 20 bytes, so recording, undoing and
+ * redoing a roll are each one copy with no allocation. Once the ring is
+ * full the oldest rolls can no longer be undone.
+ */
+#define UNDO_DEPTH 256   // power of two
+
+typedef struct undo_ring
+{
+  game_state slot[UNDO_DEPTH];
+  unsigned current;   // slot of the state on the board, or of the one it fell from
+  int back;           // rolls that can be undone
+  int ahead;          // rolls that can be redone
+}undo_ring;
+
+/* Start the history at s, the start of a level */
+static inline void undo_reset(undo_ring *r,const game_state *s)
+{
+  r->current=0;
+  r->slot[0]=*s;
+  r->back=0;
+  r->ahead=0;
+}
+
+/* Note the roll that led to s and ended with the MOVE_* outcome. A fall is
+   not kept: undoing it goes back to the state the block fell from. */
+static inline void undo_record(undo_ring *r,const game_state *s,int outcome)
+{
+  r->ahead=0;
+  if(outcome==MOVE_FALL)
+    return;
+  r->current=(r->current+1)&(UNDO_DEPTH-1);
+  r->slot[r->current]=*s;
+  if(r->back<UNDO_DEPTH-1)
+    r->back++;
+}
+
+/* Undo (way<0) or redo (way>0) one roll into s, where fallen says s is a
+   fall undo_record() didn't keep. Returns 0 if there is nothing to undo or
+   redo. */
+static inline int undo_step(undo_ring *r,game_state *s,int way,int fallen)
+{
+  if(fallen)
+  {
+    if(way>0)
+      return 0;
+  }
+  else if(way<0)
+  {
+    if(!r->back)
+      return 0;
+    r->current=(r->current-1)&(UNDO_DEPTH-1);
+    r->back--;
+    r->ahead++;
+  }
+  else
+  {
+    if(!r->ahead)
+      return 0;
+    r->current=(r->current+1)&(UNDO_DEPTH-1);
+    r->ahead--;
+    r->back++;
+  }
+  *s=r->slot[r->current];
+  return 1;
+}
+
+#endif
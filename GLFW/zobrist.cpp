@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "zobrist.h"
+
+// the four rolls, then undo and redo
+static const char dir_names[HASH_REDO+2]="LRUDZY";
+
+static uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z=(*x+=0x9e3779b97f4a7c15ull);
+  z=(z^(z>>30))*0xbf58476d1ce4e5b9ull;
+  z=(z^(z>>27))*0x94d049bb133111ebull;
+  return z^(z>>31);
+}
+
+void init_zobrist(zobrist_keys *z,const level_board *b)
+{
+  uint64_t seed=0x5a0b15ull;
+  int i;
+
+  z->block.resize(b->tiles.size()*3);
+  for(i=0;i<(int)z->block.size();i++)
+    z->block[i]=splitmix64(&seed);
+  for(i=0;i<MAX_GROUPS;i++)
+    z->group[i]=splitmix64(&seed);
+  for(i=0;i<MAX_CRUMBLE;i++)
+    z->crumble[i]=splitmix64(&seed);
+  z->tick[0]=0;
+  for(i=1;i<MAX_PERIOD;i++)
+    z->tick[i]=splitmix64(&seed);
+}
+
+static inline uint64_t block_key(const zobrist_keys *z,const level_board *b,uint32_t block)
+{
+  return z->block[cell_index(b,block_x(block),block_z(block))*3+block_orient(block)];
+}
+
+/* XOR of the keys of every set bit in bits */
+static inline uint64_t bit_keys(const uint64_t *keys,uint32_t bits)
+{
+  uint64_t h=0;
+
+  while(bits)
+  {
+    h^=keys[__builtin_ctz(bits)];
+    bits&=bits-1;
+  }
+  return h;
+}
+
+uint64_t zobrist_hash(const zobrist_keys *z,const level_board *b,const game_state *s)
+{
+  return block_key(z,b,s->block) ^ bit_keys(z->group,s->switch_check) ^ bit_keys(z->crumble,s->damage) ^ z->tick[s->tick];
+}
+
+uint64_t zobrist_update(const zobrist_keys *z,const level_board *b,uint64_t h,const game_state *before,const game_state *after)
+{
+  h^=block_key(z,b,before->block) ^ block_key(z,b,after->block);
+  // most rolls change neither word
+  if(before->switch_check!=after->switch_check)
+    h^=bit_keys(z->group,before->switch_check^after->switch_check);
+  if(before->damage!=after->damage)
+    h^=bit_keys(z->crumble,before->damage^after->damage);
+  return h^z->tick[before->tick]^z->tick[after->tick];
+}
+
+void write_hash_entry(FILE *f,const hash_entry *e)
+{
+  fprintf(f,"%d %c %016llx\n",e->level,dir_names[e->dir],(unsigned long long)e->hash);
+}
+
+int read_hash_stream(const char *path,std::vector<hash_entry> *entries)
+{
+  FILE *f=fopen(path,"r");
+  hash_entry e;
+  char dir;
+  unsigned long long hash;
+  int n;
+
+  if(!f)
+    return 0;
+  entries->clear();
+  while((n=fscanf(f,"%d %c %llx",&e.level,&dir,&hash))==3)
+  {
+    const char *d=strchr(dir_names,dir);
+    if(!d || !*d)
+      break;
+    e.dir=d-dir_names;
+    e.hash=hash;
+    entries->push_back(e);
+  }
+  fclose(f);
+  return n==EOF;
+}
+
+long first_divergence(const std::vector<hash_entry> &a,const std::vector<hash_entry> &b)
+{
+  size_t i;
+
+  for(i=0;i<a.size() && i<b.size();i++)
+    if(a[i].level!=b[i].level || a[i].dir!=b[i].dir || a[i].hash!=b[i].hash)
+      return i;
+  return -1;
+}
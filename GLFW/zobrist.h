@@ -0,0 +1,61 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdio.h>
+
+#include "rules.h"
+
+/*
+ * Zobrist hashing of a game state: one random key per (cell, orientation)
+ * of the block, per switch group, per crumble tile and per tick of the
+ * board's period, XORed together. The keys come from a fixed splitmix64
+ * sequence, so the same level hashes the same on every build and machine,
+ * and a roll updates the hash with a couple of XORs.
+ */
+typedef struct zobrist_keys
+{
+  std::vector<uint64_t> block;    // [cell_index*3+orientation]
+  uint64_t group[MAX_GROUPS];
+  uint64_t crumble[MAX_CRUMBLE];
+  uint64_t tick[MAX_PERIOD];      // zero for tick 0, so boards without timed tiles hash as before
+}zobrist_keys;
+
+void init_zobrist(zobrist_keys *z,const level_board *b);
+
+/* Hash of s from scratch */
+uint64_t zobrist_hash(const zobrist_keys *z,const level_board *b,const game_state *s);
+
+/* Hash of after, given h is the hash of before */
+uint64_t zobrist_update(const zobrist_keys *z,const level_board *b,uint64_t h,const game_state *before,const game_state *after);
+
+/*
+ * A hash stream is the list of moves of a session, one line per move with
+ * the level it was played on, the direction (or an undo or redo) and the
+ * state hash after it. Comparing two streams shows the first move where two
+ * runs disagree, and replaying one through step() checks it without
+ * rendering anything.
+ */
+
+/* hash_entry.dir values past the four rolls, see undo.h */
+enum {
+  HASH_UNDO=NUM_DIRS,
+  HASH_REDO=NUM_DIRS+1
+};
+
+typedef struct hash_entry
+{
+  int level;
+  int dir;
+  uint64_t hash;
+}hash_entry;
+
+void write_hash_entry(FILE *f,const hash_entry *e);
+
+/* Read a whole stream; returns 0 if the file can't be read or is malformed */
+int read_hash_stream(const char *path,std::vector<hash_entry> *entries);
+
+/* Index of the first entry where the streams differ, or -1 if one is a
+   prefix of the other */
+long first_divergence(const std::vector<hash_entry> &a,const std::vector<hash_entry> &b);
+
+#endif